@@ -42,6 +42,8 @@
 #include "MotionModels/MotionModelMethod.h"
 #include "ObservationModels/ObservationModelMethod.h"
 #include "SpaceInformation/SpaceInformation.h"
+#include "Utils/AllocationScope.h"
+#include "Visualization/Visualizer.h"
 #include "ompl/base/Cost.h"
 #include "boost/date_time/local_time/local_time.hpp"
 #include <boost/thread.hpp>
@@ -256,15 +258,14 @@ bool Controller<SeparatedControllerType, FilterType>::Execute(const ompl::base::
     //float totalCollisionCheckComputeTime = 0;
     //int totalNumCollisionChecks = 0;
 
-    ompl::base::State *internalState = si_->allocState();
+    // all temporary states of this run are released together, including on early exit
+    firm::AllocationScope scope(si_);
 
-    si_->copyState(internalState, startState);
+    ompl::base::State *internalState = scope.cloneState(startState);
 
     ompl::base::State  *nominalX_K ;
 
-    ompl::base::State *tempEndState = si_->allocState();
-
-    si_->copyState(tempEndState, startState);
+    ompl::base::State *tempEndState = scope.cloneState(startState);
 
     while(!this->isTerminated(tempEndState, k))
     {
@@ -320,7 +321,8 @@ bool Controller<SeparatedControllerType, FilterType>::Execute(const ompl::base::
         arma::mat tempCovMat = internalState->as<StateType>()->getCovariance();
         cost += arma::trace(tempCovMat);
 
-        if(!constructionMode)
+        // slow down execution so it can be watched, there is nothing to watch with the visualizer off
+        if(!constructionMode && Visualizer::isEnabled())
         {
           boost::this_thread::sleep(boost::posix_time::milliseconds(20));
         }
@@ -343,7 +345,7 @@ bool Controller<SeparatedControllerType, FilterType>::Execute(const ompl::base::
 
     int stepsToStabilize=0;
 
-    ompl::base::State *stabilizedState = si_->allocState();
+    ompl::base::State *stabilizedState = scope.allocState();
 
     //this->Stabilize(internalState, stabilizedState, stabilizationFilteringCost, stepsToStabilize, constructionMode) ;
 
@@ -358,12 +360,6 @@ bool Controller<SeparatedControllerType, FilterType>::Execute(const ompl::base::
 
     timeToStop = k;
 
-    si_->freeState(internalState);
-
-    si_->freeState(tempEndState);
-
-    si_->freeState(stabilizedState);
-
     return true ;
 }
 
@@ -381,10 +377,11 @@ bool Controller<SeparatedControllerType, FilterType>::executeOneStep(const int k
     //cost = 0.01 , for covariance based
     double cost = 0.001;
 
-    ompl::base::State *internalState = si_->allocState();
-    si_->copyState(internalState, startState);
+    firm::AllocationScope scope(si_);
 
-    ompl::base::State  *nominalX_K = si_->allocState();
+    ompl::base::State *internalState = scope.cloneState(startState);
+
+    ompl::base::State  *nominalX_K ;
 
     this->Evolve(internalState, k, endState) ;
 
@@ -419,13 +416,11 @@ bool Controller<SeparatedControllerType, FilterType>::executeOneStep(const int k
     arma::mat tempCovMat = endState->as<StateType>()->getCovariance();
     cost += arma::trace(tempCovMat);
 
-    if(!constructionMode) boost::this_thread::sleep(boost::posix_time::milliseconds(20));
+    if(!constructionMode && Visualizer::isEnabled()) boost::this_thread::sleep(boost::posix_time::milliseconds(20));
 
     //filteringCost.v = cost;
     filteringCost = ompl::base::Cost(cost);
 
-    si_->freeState(internalState);
-
     return true ;
 }
 
@@ -515,6 +510,10 @@ void Controller<SeparatedControllerType, FilterType>::Evolve(const ompl::base::S
 
     si_->setBelief(nextBelief);
 
+    si_->freeState(nextBelief);
+
+    separatedController_.releaseFeedbackControl(control);
+
 }
 
 
@@ -551,7 +550,7 @@ void Controller<SeparatedControllerType, FilterType>::Stabilize(const ompl::base
 
         tries_++;
 
-        if(!constructionMode)
+        if(!constructionMode && Visualizer::isEnabled())
         {
             boost::this_thread::sleep(boost::posix_time::milliseconds(20));
         }
@@ -107,6 +107,35 @@ class KalmanFilterMethod
 
 	protected:
 
+        /** \brief  Kalman update for an observation whose noise is independent per element, i.e. a diagonal R given as
+                the vector of its variances. The elements are folded in one at a time as scalar updates around the same
+                linearization, which gives the batch result without forming or solving the full innovation covariance,
+                so the cost is linear in the observation size. */
+        static void sequentialUpdate(const arma::colvec &xPred, const arma::mat &covPred, const arma::mat &H,
+                                     const arma::colvec &rVariances, const arma::colvec &innov, arma::colvec &xEst, arma::mat &covEst)
+        {
+            xEst = xPred;
+            covEst = covPred;
+
+            for(unsigned int i = 0; i < innov.n_rows; i++)
+            {
+                const arma::rowvec h = H.row(i);
+
+                const arma::colvec Ph = covEst*h.t();
+
+                const double s = arma::dot(h, Ph) + rVariances[i];
+
+                // the innovation was taken at the prediction, account for how far the earlier elements moved the estimate
+                const double y = innov[i] - arma::dot(h, xEst - xPred);
+
+                const arma::colvec K = Ph / s;
+
+                xEst += K*y;
+
+                covEst -= K*Ph.t();
+            }
+        }
+
         /** \brief Pointer to the space information.*/
         firm::SpaceInformation::SpaceInformationPtr si_;
 
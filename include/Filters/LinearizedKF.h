@@ -83,6 +83,13 @@ class LinearizedKF : public KalmanFilterMethod
             an open loop trajectory. Helps to understand the expected uncertainty at a point in the trajectory.*/
     arma::mat computeStationaryCovariance (const LinearSystem& ls);
 
+    /** \brief  Compute the stationary covariance from the stationary predicted covariance, i.e. the solution of the
+            DARE given by stationaryRiccatiProblem, when that was solved elsewhere (e.g. by dareBatch).*/
+    arma::mat computeStationaryCovariance (const LinearSystem& ls, const arma::mat &stationaryPrediction);
+
+    /** \brief  The DARE (in control form) whose solution is the stationary predicted covariance of the linear system.*/
+    static void stationaryRiccatiProblem(const LinearSystem& ls, arma::mat &A, arma::mat &B, arma::mat &Q, arma::mat &R);
+
 };
 
 #endif
@@ -38,10 +38,41 @@
 #define DARE_
 
 #include "armadillo"
+#include <algorithm>
 #include <cassert>
+#include <vector>
 
-/** \brief Solver for the Differential Algebraic Riccatti Equation. */
-inline bool dare(const arma::mat& _A, const arma::mat& _B, const arma::mat& _Q, const arma::mat& _R, arma::mat &S)
+/**
+    @par Notes
+    All solvers below return the stabilizing solution S of the Discrete Algebraic Riccati Equation
+
+        S = A'SA - A'SB(R + B'SB)^-1 B'SA + Q
+
+    dare() is the default entry point. It runs the structure-preserving doubling algorithm (SDA), which converges
+    quadratically and only needs n x n solves, and falls back to the Hamiltonian eigenvector method if SDA does
+    not converge. dareWarmStart() refines a nearby solution (e.g. from a neighboring node) with Newton-Kleinman
+    iterations. dareBatch() solves a sequence of related problems, warm starting each from the previous one.
+*/
+
+namespace dare_detail
+{
+    /** \brief Max SDA iterations, each doubles the horizon so 30 covers any stabilizable system we handle. */
+    static const int SDA_MAX_ITERATIONS = 30;
+
+    /** \brief Max Newton-Kleinman iterations for a warm start before falling back to a cold solve. */
+    static const int NEWTON_MAX_ITERATIONS = 8;
+
+    /** \brief Relative tolerance on successive iterates. */
+    static const double CONVERGENCE_TOLERANCE = 1e-10;
+
+    inline bool hasConverged(const arma::mat &Snew, const arma::mat &Sold)
+    {
+        return arma::norm(Snew - Sold, 1) <= CONVERGENCE_TOLERANCE * std::max(1.0, arma::norm(Snew, 1));
+    }
+}
+
+/** \brief Solver for the Discrete Algebraic Riccatti Equation using the eigenvectors of the Hamiltonian. */
+inline bool dareHamiltonian(const arma::mat& _A, const arma::mat& _B, const arma::mat& _Q, const arma::mat& _R, arma::mat &S)
 
 {
     using namespace arma;
@@ -126,6 +157,141 @@ inline bool dare(const arma::mat& _A, const arma::mat& _B, const arma::mat& _Q,
     return true; // dare solved successfuly
 }
 
+/** \brief Solver for the Discrete Algebraic Riccatti Equation using the structure-preserving doubling algorithm. */
+inline bool dareSDA(const arma::mat& _A, const arma::mat& _B, const arma::mat& _Q, const arma::mat& _R, arma::mat &S)
+{
+    using namespace arma;
+
+    const int n = _A.n_rows;
+
+    const mat I = eye<mat>(n,n);
+
+    mat Ak = _A;
+    mat Gk = _B * solve(_R, trans(_B));
+    mat Hk = _Q;
+
+    for(int k = 0; k < dare_detail::SDA_MAX_ITERATIONS; k++)
+    {
+        mat W = I + Gk * Hk;
+
+        mat WiA, WiG;
+
+        if(!solve(WiA, W, Ak) || !solve(WiG, W, Gk))
+            return false;
+
+        mat Hn = Hk + trans(Ak) * Hk * WiA;
+
+        if(!Hn.is_finite())
+            return false;
+
+        if(dare_detail::hasConverged(Hn, Hk))
+        {
+            S = (Hn + trans(Hn)) / 2;
+            return true;
+        }
+
+        Gk = Gk + Ak * WiG * trans(Ak);
+        Ak = Ak * WiA;
+        Hk = Hn;
+    }
+
+    return false;
+}
+
+/** \brief Solver for the Discrete Algebraic Riccatti Equation. */
+inline bool dare(const arma::mat& _A, const arma::mat& _B, const arma::mat& _Q, const arma::mat& _R, arma::mat &S)
+{
+    if(dareSDA(_A, _B, _Q, _R, S))
+        return true;
+
+    return dareHamiltonian(_A, _B, _Q, _R, S);
+}
+
+/** \brief Solve the DARE starting from the solution S0 of a nearby problem (e.g. a neighboring node).
+    Uses Newton-Kleinman iterations, each solving a Stein equation, and falls back to dare() if S0
+    does not give a stabilizing gain or the iterations do not converge. */
+inline bool dareWarmStart(const arma::mat& _A, const arma::mat& _B, const arma::mat& _Q, const arma::mat& _R, const arma::mat &S0, arma::mat &S)
+{
+    using namespace arma;
+
+    const int n = _A.n_rows;
+
+    if(S0.n_rows == n && S0.n_cols == n && S0.is_finite())
+    {
+        const mat In2 = eye<mat>(n*n, n*n);
+
+        mat Sk = S0;
+
+        for(int k = 0; k < dare_detail::NEWTON_MAX_ITERATIONS; k++)
+        {
+            mat K;
+
+            if(!solve(K, _R + trans(_B) * Sk * _B, trans(_B) * Sk * _A))
+                break;
+
+            mat Ac = _A - _B * K;
+
+            // the gain has to be stabilizing for the Newton step to be valid
+            if(max(abs(eig_gen(Ac))) >= 1.0)
+                break;
+
+            // Stein equation Sn = Ac' Sn Ac + Q + K'RK, solved in vectorized form
+            colvec vecSn;
+
+            if(!solve(vecSn, In2 - kron(trans(Ac), trans(Ac)), vectorise(mat(_Q + trans(K) * _R * K))))
+                break;
+
+            mat Sn = reshape(vecSn, n, n);
+
+            Sn = (Sn + trans(Sn)) / 2;
+
+            if(dare_detail::hasConverged(Sn, Sk))
+            {
+                S = Sn;
+                return true;
+            }
+
+            Sk = Sn;
+        }
+    }
+
+    return dare(_A, _B, _Q, _R, S);
+}
+
+/** \brief Solve a batch of DAREs, e.g. for many roadmap nodes at once. Problem i is warm started from the last
+    solved problem before it, so callers should order neighboring linearizations next to each other.
+    Returns the number of problems that were solved; solved[i] tells which. */
+inline unsigned int dareBatch(const std::vector<arma::mat>& As, const std::vector<arma::mat>& Bs,
+                              const std::vector<arma::mat>& Qs, const std::vector<arma::mat>& Rs,
+                              std::vector<arma::mat> &Ss, std::vector<bool> &solved)
+{
+    assert(As.size() == Bs.size() && As.size() == Qs.size() && As.size() == Rs.size());
+
+    Ss.assign(As.size(), arma::mat());
+
+    solved.assign(As.size(), false);
+
+    unsigned int numSolved = 0;
+
+    int lastSolved = -1;
+
+    for(unsigned int i = 0; i < As.size(); i++)
+    {
+        if(lastSolved >= 0)
+            solved[i] = dareWarmStart(As[i], Bs[i], Qs[i], Rs[i], Ss[lastSolved], Ss[i]);
+        else
+            solved[i] = dare(As[i], Bs[i], Qs[i], Rs[i], Ss[i]);
+
+        if(solved[i])
+        {
+            lastSolved = i;
+            numSolved++;
+        }
+    }
+
+    return numSolved;
+}
+
 /** \brief Generate a gain using the DARE solver */
 inline arma::mat generate_gain_with_dare(const arma::mat _A, const arma::mat _B, const arma::mat _Q, const arma::mat _R)
 {
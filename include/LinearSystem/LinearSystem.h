@@ -133,6 +133,12 @@ class LinearSystem
     /** \brief  Get the observation noise covariance. */
     arma::mat getR() const { return observationModel_->getObservationNoiseCovariance(x_, z_); }
 
+    /** \brief  True if the observation noise covariance is diagonal, see getRVariance. */
+    bool hasIndependentObservationNoise() const { return observationModel_->hasIndependentNoise(); }
+
+    /** \brief  Get the diagonal of the observation noise covariance. */
+    arma::colvec getRVariance() const { return observationModel_->getObservationNoiseVariance(x_, z_); }
+
   private:
 
     /** \brief Pointer to space information. */
@@ -38,6 +38,8 @@
 #define MOTIONMODELMETHOD_
 
 #include <armadillo>
+#include <map>
+#include <vector>
 #include "Spaces/SE2BeliefSpace.h"
 #include <ompl/control/Control.h>
 #include <ompl/control/spaces/RealVectorControlSpace.h>
@@ -149,6 +151,46 @@ class MotionModelMethod
         /** \brief Get the time step value. */
         virtual double getTimestepSize() { return dt_; }
 
+        /** \brief Allocate a control. Controls released on the calling thread through freeControl are reused first. */
+        ompl::control::Control* allocControl()
+        {
+            std::vector<ompl::control::Control*> &recycled = recycledControls().controls[controlDim_];
+
+            if(recycled.empty())
+                return si_->allocControl();
+
+            ompl::control::Control *control = recycled.back();
+
+            recycled.pop_back();
+
+            return control;
+        }
+
+        /** \brief Release a control obtained from allocControl/ARMA2OMPL. The zero control is never released. */
+        void freeControl(ompl::control::Control *control)
+        {
+            if(!control || control == zeroControl_)
+                return;
+
+            std::vector<ompl::control::Control*> &recycled = recycledControls().controls[controlDim_];
+
+            if(recycled.size() < MAX_RECYCLED_CONTROLS_PER_THREAD)
+                recycled.push_back(control);
+            else
+                si_->freeControl(control);
+        }
+
+        /** \brief Release a sequence of controls, e.g. an open loop policy that is no longer needed. */
+        void freeControls(std::vector<ompl::control::Control*> &controls)
+        {
+            for(unsigned int i = 0; i < controls.size(); i++)
+            {
+                freeControl(controls[i]);
+            }
+
+            controls.clear();
+        }
+
         /** \brief Convert a control from OMPL format to armadillo vector. */
         arma::colvec OMPL2ARMA(const ompl::control::Control *control)
         {
@@ -170,7 +212,7 @@ class MotionModelMethod
         /** \brief Convert a control from aradillo vector to ompl::control::Control* . */
         void ARMA2OMPL(arma::colvec u, ompl::control::Control *control)
         {
-            if(!control) control = si_->allocControl();
+            if(!control) control = allocControl();
 
             for (unsigned int i = 0; i < controlDim_; i++)
             {
@@ -180,7 +222,7 @@ class MotionModelMethod
 
         ompl::control::Control* ARMA2OMPL(arma::colvec u)
         {
-            ompl::control::Control *control = si_->allocControl();
+            ompl::control::Control *control = allocControl();
 
             for (unsigned int i = 0; i < controlDim_; i++)
             {
@@ -192,6 +234,37 @@ class MotionModelMethod
 
 	protected:
 
+        /** \brief The maximum number of released controls a thread keeps around for reuse. */
+        static const std::size_t MAX_RECYCLED_CONTROLS_PER_THREAD = 4096;
+
+        /** \brief Per-thread lists of released controls, keyed by control dimension. All motion models
+            use real vector controls, so a released control can be handed to any model of the same dimension.
+            Whatever is left is freed when the thread exits. */
+        struct RecycledControls
+        {
+            ~RecycledControls()
+            {
+                for(std::map<unsigned int, std::vector<ompl::control::Control*> >::iterator i = controls.begin(); i != controls.end(); ++i)
+                {
+                    for(unsigned int j = 0; j < i->second.size(); j++)
+                    {
+                        // mirrors RealVectorControlSpace::freeControl
+                        ompl::control::RealVectorControlSpace::ControlType *rcontrol = static_cast<ompl::control::RealVectorControlSpace::ControlType*>(i->second[j]);
+                        delete[] rcontrol->values;
+                        delete rcontrol;
+                    }
+                }
+            }
+
+            std::map<unsigned int, std::vector<ompl::control::Control*> > controls;
+        };
+
+        static RecycledControls& recycledControls()
+        {
+            static thread_local RecycledControls recycled;
+            return recycled;
+        }
+
         /** \brief A pointer to the space information. */
 	    ompl::control::SpaceInformationPtr si_;
 
@@ -39,6 +39,9 @@
 
 #include "ObservationModelMethod.h"
 #include <boost/math/constants/constants.hpp>
+#include <atomic>
+#include <memory>
+#include <unordered_map>
 /**
   @par Short Description
   This is an Observation model method based on the combination of a monocular camera,
@@ -77,10 +80,19 @@ class CamAruco2DObservationModel : public ObservationModelMethod
         // initialize etaPhi_, etaD_, sigma_;
         this->loadLandmarks(pathToSetupFile);
         this->loadParameters(pathToSetupFile);
+        this->buildLandmarkIndex();
+        this->buildVisibilityRasters();
     }
 
     ObservationType getObservation(const ompl::base::State *state, bool isSimulation);
 
+    /** \brief Writes the observation into z, which is sized once for the whole observation */
+    void getObservation(const ompl::base::State *state, bool isSimulation, ObservationType &z);
+
+    /** \brief Observes many states at once. States are grouped by landmark grid cell and range/bearing to each candidate
+        landmark is computed for the whole group in one loop over the landmark geometry arrays. */
+    void getObservations(const std::vector<const ompl::base::State*> &states, bool isSimulation, std::vector<ObservationType> &observations);
+
     ObservationType getObservationPrediction(const ompl::base::State *state, const ObservationType& Zg);
 
      /** \brief Find the observation based on the given state and landmark to a correspongind landmark.
@@ -97,22 +109,48 @@ class CamAruco2DObservationModel : public ObservationModelMethod
 
     // Jx = dh/dx
     JacobianType getObservationJacobian(const ompl::base::State *state, const ObsNoiseType& v, const ObservationType& z);
+
+    /** \brief Jacobians for many states at once, the landmarks are associated and differentiated straight from the
+        landmark geometry arrays instead of building a predicted observation per state */
+    void getObservationJacobians(const std::vector<const ompl::base::State*> &states, const std::vector<ObservationType> &observations,
+                                 std::vector<JacobianType> &jacobians);
     // Jv = dh/dv
     JacobianType getNoiseJacobian(const ompl::base::State *state, const ObsNoiseType& v, const ObservationType& z);
 
     ObservationType computeInnovation(const ompl::base::State *predictedState, const ObservationType& Zg);
 
+    /** \brief Innovations for many states at once. For every observed landmark the range and bearing to each landmark
+        with its id is computed for all states in one loop over the landmark geometry arrays. */
+    void computeInnovations(const std::vector<const ompl::base::State*> &predictedStates, const ObservationType& Zg,
+                            std::vector<ObservationType> &innovations);
+
     arma::mat getObservationNoiseCovariance(const ompl::base::State *state, const ObservationType& z);
 
-    /** \brief Checks if there is a clear line of sight from the robot to the landmark */
-    bool hasClearLineOfSight(const ompl::base::State *state, const arma::colvec& landmark);
+    /** \brief Range and bearing noise is independent for every landmark */
+    bool hasIndependentNoise() const { return true; }
+
+    arma::colvec getObservationNoiseVariance(const ompl::base::State *state, const ObservationType& z);
+
+    /** \brief Checks if there is a clear line of sight from the robot to landmarks_[landmarkIndex]. Answers come from the
+        landmark's visibility raster, a cell is ray marched the first time it is queried and remembered until the obstacles change. */
+    bool hasClearLineOfSight(const ompl::base::State *state, const unsigned int landmarkIndex);
+
+    /** \brief Forget every cached line of sight, called when the obstacles change */
+    void clearVisibilityCache();
 
-    bool isLandmarkVisible(const ompl::base::State *state, const arma::colvec& landmark, double& range, double& bearing, double& viewingAngle);
+    /** \brief Forget the cached lines of sight whose ray crosses one of the changed boxes, one column
+        (minX, minY, maxX, maxY) per box */
+    void clearVisibilityCache(const arma::mat &changedRegions);
+
+    /** \brief Checks if landmarks_[landmarkIndex] is in the camera's field of view and line of sight */
+    bool isLandmarkVisible(const ompl::base::State *state, const unsigned int landmarkIndex, double& range, double& bearing, double& viewingAngle);
 
     //void WriteLandmarks();
 
     bool isStateObservable(const ompl::base::State *state);
 
+    void areStatesObservable(const std::vector<const ompl::base::State*> &states, std::vector<bool> &observable);
+
   private:
 
     ObservationType removeSpuriousObservations(const ObservationType& Zg);
@@ -123,11 +161,59 @@ class CamAruco2DObservationModel : public ObservationModelMethod
     /** \brief Calculates the likelihood of an observation prediction */
     double getDataAssociationLikelihood(const arma::colvec trueObs, const arma::colvec predictedObs);
 
+    /** \brief Same association as findCorrespondingLandmark for the pose (x, y, yaw), computed from the landmark geometry
+        arrays. Returns the position in the landmark list and the predicted range and bearing to it. */
+    int findCorrespondingLandmark(const double x, const double y, const double yaw, const int landmarkID, const double range, const double bearing,
+                                  double &predictedRange, double &predictedBearing) const;
+
     /** \brief Given a landmark that the robot observes (id, range, bearing..) Find the corresponding landmark,returns the position in the landmark list  */
     int findCorrespondingLandmark(const ompl::base::State *state, const arma::colvec &observedLandmark, arma::colvec &candidateObservation);
 
+    /** \brief Collects the indices (in landmarks_ order) of the landmarks that can be within camera range of the state */
+    void getLandmarksInRange(const ompl::base::State *state, std::vector<unsigned int> &indices) const;
+
+    /** \brief Buckets the landmarks in a grid of camera range sized cells and indexes them by id */
+    void buildLandmarkIndex();
+
+    /** \brief Key of a cell in the landmark grid */
+    static long long landmarkCellKey(const int cellX, const int cellY);
+
+    /** \brief Line of sight from (x, y) to landmarks_[landmarkIndex], answered from the landmark's raster */
+    bool hasClearLineOfSight(const double x, const double y, const unsigned int landmarkIndex);
+
+    /** \brief Ray march from (x, y) to the landmark, checking validity every ONE_STEP_DISTANCE_FOR_VISIBILITY */
+    bool marchLineOfSight(const double x, const double y, const arma::colvec& landmark);
+
+    /** \brief Allocate an empty visibility raster around every landmark */
+    void buildVisibilityRasters();
+
+    /**
+    \brief Line of sight from the cells of a square of half width cameraRange_ around a landmark. Every cell is
+    unknown until queried, then visible or blocked. Cells are atomic so concurrent observations can fill them.
+    */
+    struct VisibilityRaster
+    {
+        double originX, originY;
+
+        int size;
+
+        std::unique_ptr<std::atomic<unsigned char>[]> cells;
+    };
+
     std::vector<arma::colvec> landmarks_;
 
+    /** \brief One raster per landmark, in landmarks_ order */
+    std::vector<VisibilityRaster> visibility_;
+
+    /** \brief Landmark geometry in landmarks_ order, kept as flat arrays for the batch range/bearing kernel */
+    std::vector<double> landmarkX_, landmarkY_, landmarkCosTheta_, landmarkSinTheta_;
+
+    /** \brief Landmarks in each grid cell, a state only sees landmarks in its own cell and the 8 around it */
+    std::unordered_map<long long, std::vector<unsigned int> > landmarkGrid_;
+
+    /** \brief Landmark id to the indices of the landmarks with that id */
+    std::unordered_map<int, std::vector<unsigned int> > landmarkIdIndex_;
+
     //Function to load landmarks from XML file into the object
     void loadLandmarks(const char *pathToSetupFile);
 
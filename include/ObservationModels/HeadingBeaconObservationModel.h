@@ -75,6 +75,9 @@ class HeadingBeaconObservationModel : public ObservationModelMethod
     /** \brief z = h(x,v) get the observation for a given configuration, corrupted by noise from a given distribution */
     ObservationType getObservation(const ompl::base::State *state, bool isSimulation);
 
+    /** \brief Writes the observation into z, which is sized once for the whole observation */
+    void getObservation(const ompl::base::State *state, bool isSimulation, ObservationType &z);
+
     ObservationType getObservationPrediction(const ompl::base::State *state, const ObservationType& Zg);
 
      /** \brief Find the observation based on the given state and landmark to a corresponding landmark.
@@ -101,6 +104,12 @@ class HeadingBeaconObservationModel : public ObservationModelMethod
     /** \brief The sensor noise covariance */
     arma::mat getObservationNoiseCovariance(const ompl::base::State *state, const ObservationType& z);
 
+    /** \brief The heading and every beacon range have independent noise */
+    bool hasIndependentNoise() const { return true; }
+
+    /** \brief The diagonal of the sensor noise covariance */
+    arma::colvec getObservationNoiseVariance(const ompl::base::State *state, const ObservationType& z);
+
     bool isStateObservable(const ompl::base::State *state);
 
   private:
@@ -39,6 +39,7 @@
 
 #include "armadillo"
 #include <ompl/control/SpaceInformation.h>
+#include <vector>
 
 /**
   @par Short Description
@@ -66,6 +67,25 @@ class ObservationModelMethod
         */
         virtual ObservationType getObservation(const ompl::base::State *state, bool isSimulation) = 0;
 
+        /** \brief Same as getObservation, but writes into z so that a caller can reuse one buffer across calls. */
+        virtual void getObservation(const ompl::base::State *state, bool isSimulation, ObservationType &z)
+        {
+            z = getObservation(state, isSimulation);
+        }
+
+        /** \brief Batch form of getObservation, observations[i] is the observation of states[i]. Models that can
+            share work between nearby states (landmark lookups, vectorized range/bearing) should override this.
+        */
+        virtual void getObservations(const std::vector<const ompl::base::State*> &states, bool isSimulation, std::vector<ObservationType> &observations)
+        {
+            observations.resize(states.size());
+
+            for(unsigned int i = 0; i < states.size(); i++)
+            {
+                getObservation(states[i], isSimulation, observations[i]);
+            }
+        }
+
         /** \brief Get the predicted observation based on predicted state.
 
             @para
@@ -86,18 +106,78 @@ class ObservationModelMethod
         /** \brief Calculate the observation Jacobian i.e. Jx = dh/dx, where h is the observation model and x is the state. */
         virtual ObsToStateJacobianType getObservationJacobian(const ompl::base::State *state, const NoiseType& v, const ObservationType& z) = 0;
 
+        /** \brief Batch form of getObservationJacobian with zero noise, jacobians[i] is evaluated at states[i] for observations[i]. */
+        virtual void getObservationJacobians(const std::vector<const ompl::base::State*> &states, const std::vector<ObservationType> &observations,
+                                             std::vector<ObsToStateJacobianType> &jacobians)
+        {
+            assert(states.size() == observations.size());
+
+            jacobians.resize(states.size());
+
+            for(unsigned int i = 0; i < states.size(); i++)
+            {
+                jacobians[i] = getObservationJacobian(states[i], getZeroNoise(), observations[i]);
+            }
+        }
+
         /** \brief Calculates the observation noise jacobian i.e. Jv = dh/dv, where h is the observation model and v is the noise */
         virtual ObsToNoiseJacobianType getNoiseJacobian(const ompl::base::State *state, const NoiseType& v, const ObservationType& z) = 0;
 
         /** \brief Computes the innovation between observations that are predicted for the given state and the true observation. */
         virtual ObservationType computeInnovation(const ompl::base::State *predictedState, const ObservationType& Zg) = 0;
 
+        /** \brief Batch form of computeInnovation, innovations[i] is the innovation of Zg against predictedStates[i]. */
+        virtual void computeInnovations(const std::vector<const ompl::base::State*> &predictedStates, const ObservationType& Zg,
+                                        std::vector<ObservationType> &innovations)
+        {
+            innovations.resize(predictedStates.size());
+
+            for(unsigned int i = 0; i < predictedStates.size(); i++)
+            {
+                innovations[i] = computeInnovation(predictedStates[i], Zg);
+            }
+        }
+
         /** \brief Calculates the observation noise covariance.*/
         virtual arma::mat getObservationNoiseCovariance(const ompl::base::State *state, const ObservationType& z) = 0;
 
+        /** \brief True if the observation noise is independent per element, i.e. getObservationNoiseCovariance is always
+            diagonal. Filters then use getObservationNoiseVariance and update one element at a time. */
+        virtual bool hasIndependentNoise() const { return false; }
+
+        /** \brief The diagonal of the observation noise covariance. Models with independent noise should override this to
+            avoid building the full matrix. */
+        virtual arma::colvec getObservationNoiseVariance(const ompl::base::State *state, const ObservationType& z)
+        {
+            return getObservationNoiseCovariance(state, z).diag();
+        }
+
         /** \brief Checks if a state is observable. */
         virtual bool isStateObservable(const ompl::base::State *state) = 0;
 
+        /** \brief Batch form of isStateObservable, one flag per state. */
+        virtual void areStatesObservable(const std::vector<const ompl::base::State*> &states, std::vector<bool> &observable)
+        {
+            observable.resize(states.size());
+
+            for(unsigned int i = 0; i < states.size(); i++)
+            {
+                observable[i] = isStateObservable(states[i]);
+            }
+        }
+
+        /** \brief Called when the obstacles in the environment change, models that cache anything derived from
+            the state validity checker (e.g. line of sight) must drop it here. */
+        virtual void clearVisibilityCache() {}
+
+        /** \brief Called when the obstacles only changed inside the given boxes, one column (minX, minY, maxX, maxY) per
+            box. Models that can tell which cached answers depend on those regions drop only those, the default drops
+            everything. */
+        virtual void clearVisibilityCache(const arma::mat &/*changedRegions*/)
+        {
+            clearVisibilityCache();
+        }
+
         /** \brief Returns the zero observation noise.*/
         virtual const NoiseType getZeroNoise() {return zeroNoise_; }
 
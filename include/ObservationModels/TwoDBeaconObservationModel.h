@@ -75,6 +75,9 @@ class TwoDBeaconObservationModel : public ObservationModelMethod
     /** \brief z = h(x,v) get the observation for a given configuration, corrupted by noise from a given distribution */
     ObservationType getObservation(const ompl::base::State *state, bool isSimulation);
 
+    /** \brief Writes the observation into z, which is sized once for the whole observation */
+    void getObservation(const ompl::base::State *state, bool isSimulation, ObservationType &z);
+
     ObservationType getObservationPrediction(const ompl::base::State *state, const ObservationType& Zg);
 
      /** \brief Find the observation based on the given state and landmark to a corresponding landmark.
@@ -60,6 +60,9 @@
 #include "Path/FeedbackPath.h"
 #include "ConnectionStrategy/FStrategy.h"
 #include "NBM3P.h"
+#include "Utils/RoadmapJournal.h"
+#include "Utils/ObservabilityMap.h"
+#include "Utils/EdgeGrid.h"
 #include "Spaces/R2BeliefSpace.h"
 #include "Spaces/SE2BeliefSpace.h"
 
@@ -296,12 +299,19 @@ public:
         policyExecutionSI_ = executionSI;
     }
 
-    void updateCollisionChecker(const ompl::base::StateValidityCheckerPtr &svc)
-    {
-        si_->setStateValidityChecker(svc);
-        siF_->setStateValidityChecker(svc);
-        policyExecutionSI_->setStateValidityChecker(svc);
-    }
+    /** \brief Switch to a new validity checker, e.g. after the obstacles changed. Edges whose swept box touches a
+        place where an obstacle may have changed are checked again: newly blocked ones get the obstacle cost, blocked
+        ones that are free again are simulated anew, and the policy is repaired with a single DP solve. */
+    void updateCollisionChecker(const ompl::base::StateValidityCheckerPtr &svc);
+
+    /** \brief Journal every change to the roadmap to the given file as it is built, so that a long roadmap
+        construction can be recovered with loadRoadMapFromFile after a crash. */
+    void setRoadmapJournal(const std::string &pathToJournal);
+
+    /** \brief Build an observability map at the given resolution (meters) and number of heading sectors, and sample
+        new roadmap nodes from its valid and observable cells, with the Gaussian belief sampler if gaussian is true
+        and the uniform one otherwise. */
+    void setObservabilityMap(const double resolution, const unsigned int numHeadings, const bool gaussian);
 
 protected:
 
@@ -348,7 +358,10 @@ protected:
     /** \brief Add an edge from vertex a to b in graph */
     virtual void addEdgeToGraph(const FIRM::Vertex a, const FIRM::Vertex b, bool &edgeAdded);
 
-    /** \brief Generates the cost of the edge */
+    /** \brief Generates the cost of the edge. The Monte Carlo particles start at the current simulation time of the
+        executing robot (policyExecutionSI_), so with scheduled obstacles the cost reflects where they are at that
+        moment. Edges added while the roadmap is built keep that cost (in the DP and in saved roadmaps) until they are
+        revalidated; only edges generated during rollout are evaluated at the time the robot actually takes them. */
     virtual FIRMWeight generateEdgeControllerWithCost(const Vertex a, const Vertex b, EdgeControllerType &edgeController);
 
     /** \brief Generates an edge controller and loads the edge properties from XML */
@@ -360,6 +373,12 @@ protected:
     /** \brief Generates the node controller that stabilizes the robot to the node and sets the stationary covariance at the node. */
     virtual void generateNodeController(ompl::base::State *state, NodeControllerType &nodeController);
 
+    /** \brief Generates the node controller for a stationary covariance that was already computed and sets it at the node. */
+    virtual void generateNodeController(ompl::base::State *state, const arma::mat &stationaryCovariance, NodeControllerType &nodeController);
+
+    /** \brief Computes the stationary covariance at each of the states, solving the DAREs of nearby states as warm started batches */
+    void computeStationaryCovariances(const std::vector<ompl::base::State*> &states, std::vector<arma::mat> &stationaryCovariances);
+
     /** \brief Solves the dynamic program to return a feedback policy */
     virtual void solveDynamicProgram(const Vertex goalVertex);
 
@@ -481,6 +500,54 @@ protected:
 
     std::vector<std::pair<std::pair<int,int>,FIRMWeight> > loadedEdgeProperties_;
 
+    /** \brief Append-only log of roadmap changes, null if journaling is off */
+    std::shared_ptr<firm::RoadmapJournal> journal_;
+
+    /** \brief Raster the roadmap samples are drawn from, null if the samplers use the whole space */
+    std::shared_ptr<firm::ObservabilityMap> observabilityMap_;
+
+    /** \brief Every edge filed under the grid cells of its swept bounding box */
+    std::shared_ptr<firm::EdgeGrid> edgeGrid_;
+
+    /** \brief File the edge a->b in edgeGrid_ */
+    void indexEdge(const Vertex a, const Vertex b);
+
+    /** \brief Take the edge from a to b out of the edge grid, must be called before a or b is removed from the graph */
+    void unindexEdge(const Vertex a, const Vertex b);
+
+    /** \brief The box in which the edge grid files the edge from a to b */
+    void edgeBounds(const Vertex a, const Vertex b, double &minX, double &minY, double &maxX, double &maxY);
+
+    /** \brief Find the edge grid cells over the state space bounds that have an obstacle in them under either checker.
+        Each column of changedRegions is the box (minX, minY, maxX, maxY) of one such cell. */
+    void findChangedRegions(const ompl::base::StateValidityCheckerPtr &previous, const ompl::base::StateValidityCheckerPtr &current,
+                            arma::mat &changedRegions);
+
+    /** \brief Check the edges filed under the changed cells found by findChangedRegions again */
+    void revalidateChangedEdges(const arma::mat &changedRegions);
+
+    /** \brief Collect the nodes and edge weights of the roadmap in the layout used by the XML roadmap */
+    void getRoadmapSnapshot(firm::RoadmapJournal::NodeList &nodes, firm::RoadmapJournal::EdgeList &edgeWeights);
+
+    /** \brief Record a new node in the journal */
+    void journalNode(const Vertex v);
+
+    /** \brief Record the edge a->b and its current weight in the journal */
+    void journalEdge(const Vertex a, const Vertex b);
+
+    /** \brief Record the current weight of an edge in the journal */
+    void journalEdgeWeight(const Edge e);
+
+    /** \brief Compact the journal into a snapshot once it has grown long enough, expects graphMutex_ to be held */
+    void compactJournalIfNeeded();
+
+    /** \brief Plan a path from start to goalVertex, the roadmap node at goal. The start is connected to the closest nodes
+        within NNRadius_ it can reach in a straight line and the shortest route to goal over the roadmap is found with A*,
+        skipping the edges already known to be blocked. The edges on the route are checked again (without holding the
+        graph lock) and the search is repeated without those that became invalid. Returns false if the roadmap does not
+        connect the two, NBM3P uses this in place of RRT* when the roadmap path provider is selected. */
+    bool planRoadmapPath(const ompl::base::State *start, const ompl::base::State *goal, const Vertex goalVertex, ompl::geometric::PathGeometric &path);
+
     /** \brief Send the most likely path to visualizer based on start location*/
     void sendMostLikelyPathToViz(const Vertex start, const Vertex goal);
 
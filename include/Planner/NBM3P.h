@@ -43,11 +43,16 @@
 #include <boost/graph/adjacency_list.hpp>
 #include <boost/pending/disjoint_sets.hpp>
 #include <boost/thread.hpp>
+#include <boost/function.hpp>
 #include <ompl/geometric/SimpleSetup.h>
 #include <ompl/control/Control.h>
 #include <ompl/base/Cost.h>
+#include <unordered_map>
+#include <unordered_set>
 #include "SpaceInformation/SpaceInformation.h"
 #include "Filters/ExtendedKF.h"
+#include "Utils/ObservationSignatureIndex.h"
+#include "Utils/AllocationScope.h"
 
 /** \para
 NBM3P is a planner for Non-Gaussian Belief State. Stated simply, its job is to generate the best next control to disambiguate the belief
@@ -100,6 +105,9 @@ class NBM3P
         {
             previousPolicy_.push_back(si_->getMotionModel()->getZeroControl());
             policyExecutionSI_ = si_;
+            maxNumberOfModes_ = 0;
+            roundBudget_ = 0;
+            previousPolicyStep_ = 0;
         }
 
         /** \brief Destructor */
@@ -115,6 +123,35 @@ class NBM3P
         /** \brief This function samples the beliefs, which form the starting point for the multi-modal scenario*/
         void sampleNewBeliefStates();
 
+        /** \brief Set the maximum number of modes kept after sampling, more are merged into their neighbors. 0 disables merging. */
+        void setMaxNumberOfModes(const unsigned int maxModes)
+        {
+            maxNumberOfModes_ = maxModes;
+        }
+
+        /** \brief Set a wall clock budget in seconds for each call to generatePolicy, 0 for no budget. When the budget runs out
+            the best policy evaluated on every mode so far is returned. If there is none the previous policy is resumed from
+            the first control that was not yet applied. */
+        void setPolicyGenerationBudget(const double seconds)
+        {
+            roundBudget_ = seconds;
+        }
+
+        /** \brief Plans a path from a state to a roadmap node, given by its state and its vertex in the roadmap, returns
+            false if it cannot connect them */
+        typedef boost::function<bool (const ompl::base::State*, const ompl::base::State*, const Vertex, ompl::geometric::PathGeometric&)> PathProvider;
+
+        /** \brief Plan the candidate paths from each mode to its target with the given provider (e.g. a search over an
+            existing roadmap). Modes the provider cannot connect fall back to RRT*. */
+        void setPathProvider(const PathProvider &provider)
+        {
+            pathProvider_ = provider;
+        }
+
+        /** \brief Load the observation signature index used to seed the modes from the given file, building and saving it
+            there if it does not exist yet. Without an index sampleNewBeliefStates grids the whole environment. */
+        void loadObservationSignatureIndex(const std::string &pathToFile);
+
         /** \brief Compute distance between two milestones (this is simply distance between the states of the milestones) */
         double distanceFunction(const Vertex a, const Vertex b) const
         {
@@ -126,19 +163,23 @@ class NBM3P
         {
             currentBeliefStates_.clear();
             weights_.clear();
+            timeSinceDivergence_.clear();
 
             for(unsigned int i = 0; i < states.size(); i++)
             {
                 currentBeliefStates_.push_back(si_->cloneState(states[i]));
                 weights_.push_back(1.0/states.size()); // assign equal weights to all
+                timeSinceDivergence_.push_back(0.0);
             }
 
         }
 
-        /** \brief Add the FIRM node as a state to the observation graph*/
-        void addFIRMNodeToObservationGraph(ompl::base::State *state)
+        /** \brief Add the FIRM node as a state to the observation graph, roadmapVertex is its vertex in the FIRM roadmap*/
+        void addFIRMNodeToObservationGraph(ompl::base::State *state, const Vertex roadmapVertex)
         {
             this->addStateToObservationGraph(si_->cloneState(state));
+
+            roadmapVertices_[boost::num_vertices(g_) - 1] = roadmapVertex;
         }
 
         /** \brief For each belief state, there is a target node to go to, set those here */
@@ -148,7 +189,7 @@ class NBM3P
 
             for(unsigned int i = 0; i < states.size(); i++)
             {
-                addFIRMNodeToObservationGraph(si_->cloneState(states[i]));
+                this->addStateToObservationGraph(si_->cloneState(states[i]));
                 targetStates_.push_back(si_->cloneState(states[i]));
             }
 
@@ -180,8 +221,9 @@ class NBM3P
         repeated.*/
         virtual void generatePolicy(std::vector<ompl::control::Control*> &policy);
 
-        /** \brief Runs the open loop policy on a given mode and outputs the cost*/
-        virtual ompl::base::Cost executeOpenLoopPolicyOnMode(std::vector<ompl::control::Control*> controls, const ompl::base::State* state);
+        /** \brief Runs the open loop policy on a given mode and outputs the cost. The planner's own modes and the true state
+            are left untouched, so this may be called from several threads at once. */
+        virtual ompl::base::Cost executeOpenLoopPolicyOnMode(const std::vector<ompl::control::Control*> &controls, const ompl::base::State* state) const;
 
         /** \brief advances the beliefs/modes by applying the given controls*/
         virtual void propagateBeliefs(const ompl::control::Control *control, bool isSimulation = false);
@@ -239,8 +281,105 @@ class NBM3P
             policyExecutionSI_ = executionSI;
         }
 
+        /** \brief Landmark id to its position in an observation vector */
+        typedef std::unordered_map<int, unsigned int> LandmarkIndex;
+
+        /** \brief Pair each landmark the robot sees with the first predicted landmark of the same id, predictedLandmarks is scratch
+            space for the index of the predicted ids. The range and bearing innovation of each pair is written to the front of innov,
+            which is only grown when too small so it can be reused across modes. Returns the number of pairs, which is never more
+            than the number of landmarks the robot sees. */
+        static unsigned int matchLandmarks(const arma::colvec &predictedObservation, const arma::colvec &trueObservation, LandmarkIndex &predictedLandmarks,
+                                           arma::colvec &innov);
+
     private:
 
+        /** \brief Add a mode at every valid pose on a grid over the environment */
+        void sampleGridBeliefStates(const arma::mat &cov);
+
+        /**
+        @par Description
+        A private copy of the modes on which an open loop policy is simulated with the robot placed at one of the
+        modes. It owns its true state, its modes, their weights and divergence timers, so any number of simulations
+        can run side by side without touching the planner. The belief states are updated in place through a single
+        scratch state, so no states are allocated while stepping through the controls.
+        */
+        class ModeSimulation
+        {
+            public:
+
+                /** \brief Constructor, copies the planner's current modes */
+                ModeSimulation(const NBM3P &planner);
+
+                /** \brief Destructor, frees the simulated modes that were not removed during the simulation */
+                ~ModeSimulation();
+
+                /** \brief Apply the controls with the robot starting at trueState and return the resulting information gain */
+                ompl::base::Cost run(const std::vector<ompl::control::Control*> &controls, const ompl::base::State *trueState);
+
+            private:
+
+                /** \brief Apply one control to the simulated robot and update the simulated modes with what it observes */
+                void propagate(const ompl::control::Control *control);
+
+                const NBM3P &planner_;
+
+                firm::SpaceInformation::SpaceInformationPtr si_;
+
+                /** \brief Owns the simulated robot and the filter buffer. The modes are not in it, removeBeliefs frees
+                    the ones that are dropped. */
+                firm::AllocationScope scope_;
+
+                /** \brief Filter used to update every mode */
+                ExtendedKF filter_;
+
+                ompl::base::State *trueState_;
+
+                /** \brief Filter output buffer, copied into the mode it was computed for */
+                ompl::base::State *scratchState_;
+
+                std::vector<ompl::base::State*> beliefStates_;
+
+                std::vector<float> weights_;
+
+                std::vector<double> timeSinceDivergence_;
+        };
+
+        /** \brief Updates the weights of the given modes for the given observation and removes the modes that become
+            negligible. Works on explicit containers so it can be applied to a simulation's copy of the modes. */
+        void updateWeights(const arma::colvec &trueObservation, std::vector<ompl::base::State*> &beliefStates,
+                           std::vector<float> &weights, std::vector<double> &timeSinceDivergence) const;
+
+        /** \brief Compute the innovation between the robot's observation and the one predicted at mode, updates the mode's divergence timer */
+        arma::colvec computeInnovation(const ompl::base::State *mode, const arma::colvec &trueObservation, double &timeSinceDivergence, double &weightFactor) const;
+
+        /** \brief Hash the landmark ids of an observation */
+        static void indexObservation(const arma::colvec &observation, LandmarkIndex &landmarks);
+
+        /** \brief Match the observation predicted at a mode against the robot's observation with matchLandmarks, then update the
+            mode's divergence timer. Returns the number of matched landmarks. */
+        unsigned int matchObservation(const arma::colvec &predictedObservation, const arma::colvec &trueObservation, LandmarkIndex &predictedLandmarks,
+                                      arma::colvec &innov, double &timeSinceDivergence, double &weightFactor) const;
+
+        /** \brief Remove the modes at the given indices from the given containers */
+        void removeBeliefs(const std::vector<int> &Indxs, std::vector<ompl::base::State*> &beliefStates,
+                           std::vector<float> &weights, std::vector<double> &timeSinceDivergence) const;
+
+        /** \brief Merge the duplicates among the given modes, each mode is merged into at most one other */
+        void removeDuplicateModes(std::vector<ompl::base::State*> &beliefStates, std::vector<float> &weights, std::vector<double> &timeSinceDivergence) const;
+
+        /** \brief Merge the given modes until at most maxModes remain (0 means no limit). Pairs are merged greedily by
+            the Runnalls bound on the KL divergence of the mixture, each merge preserves the weight, mean and covariance of the pair.
+            A mode is only paired with the nearest modes in the hash grid cells around it, and pairs whose merged mean is
+            invalid are skipped, so fewer than maxModes may remain. */
+        void reduceModes(std::vector<ompl::base::State*> &beliefStates, std::vector<float> &weights,
+                         std::vector<double> &timeSinceDivergence, const unsigned int maxModes) const;
+
+        /** \brief Key of the (x, y, yaw) cell used to find duplicate modes */
+        static long long modeCellKey(const long long cellX, const long long cellY, const long long cellYaw);
+
+        /** \brief Normalize the given weights */
+        static void normalizeWeights(std::vector<float> &weights);
+
         //float computeWeightForMode(const int currentBeliefIndx,const arma::colvec trueObservation);
 
          /** \brief Add the a state to the observation graph*/
@@ -249,20 +388,42 @@ class NBM3P
         /** \brief Add an edge between the two vertices */
         void addEdgeToObservationGraph(const Vertex a, const Vertex b);
 
-        /** \brief Returns the list of observations that are observed from a Vertex*/
+        /** \brief Computes and caches the list of landmarks that are observed from a Vertex*/
         void evaluateObservationListForVertex(const Vertex v);
 
         /** \brief Get the overlap in observation for two vertices*/
         virtual bool getObservationOverlap(const Vertex a, const Vertex b, unsigned int &weight);
 
+        /** \brief The neighborhoods of the current modes, computed once per call to generatePolicy */
+        struct ModeNeighborhoods
+        {
+            /** \brief Observation graph vertices near each mode, sorted */
+            std::vector<std::vector<Vertex> > neighbors;
+
+            /** \brief The same neighborhoods as hashed sets */
+            std::vector<std::unordered_set<Vertex> > neighborSets;
+
+            /** \brief For each vertex, the number of modes whose neighborhood contains it */
+            std::vector<int> coverCount;
+        };
+
+        /** \brief Key of the grid cell with the given coordinates */
+        static long long gridCellKey(const int cellX, const int cellY);
+
+        /** \brief Key of the grid cell that contains the state */
+        static long long gridCellKey(const ompl::base::State *state);
+
         /** \brief Get the nodes within some radius "r" to state */
         std::vector<Vertex> getNeighbors(const ompl::base::State *state);
 
+        /** \brief Compute the neighborhoods of all current modes */
+        void computeModeNeighborhoods(ModeNeighborhoods &neighborhoods);
+
         /** \brief Find the target location for the given state*/
-        Vertex findTarget(const unsigned int beliefStateIndx);
+        Vertex findTarget(const unsigned int beliefStateIndx, const ModeNeighborhoods &neighborhoods);
 
         /** \brief Find the total weight of the edges from v to nodes in the given neighbor set*/
-        int calculateIntersectionWithNeighbor(const Vertex v, std::vector<Vertex> neighbors);
+        int calculateIntersectionWithNeighbor(const Vertex v, const std::unordered_set<Vertex> &neighbors);
 
         /** \brief Returns true if all weights are same, false otherwise*/
         bool areSimilarWeights();
@@ -296,9 +457,24 @@ class NBM3P
         /** \brief Container for the previous open loop policy*/
         std::vector<ompl::control::Control*> previousPolicy_;
 
+        /** \brief Number of controls of the previous policy that were applied through propagateBeliefs */
+        unsigned int previousPolicyStep_;
+
         /** \brief Container for the current weights of the beliefs */
         std::vector<float> weights_;
 
+        /** \brief The number of modes is reduced to this after sampling, 0 for no limit */
+        unsigned int maxNumberOfModes_;
+
+        /** \brief Wall clock budget of a generatePolicy round in seconds, 0 for none */
+        double roundBudget_;
+
+        /** \brief Optional planner for the mode to target paths, tried before RRT* */
+        PathProvider pathProvider_;
+
+        /** \brief Maps observations to the poses they can be seen from, used to seed the modes after a kidnapping */
+        std::shared_ptr<firm::ObservationSignatureIndex> signatureIndex_;
+
         /** \brief connectivity graph (observation graph) */
         Graph                                                  g_;
 
@@ -317,8 +493,20 @@ class NBM3P
             boost::property_map<Graph, boost::vertex_rank_t>::type,
             boost::property_map<Graph, boost::vertex_predecessor_t>::type >
                                                                     disjointSets_;*/
-        /** \brief Stores the list of ids of landmarks that a vertex in the graph can see*/
-        std::map<Vertex, std::vector<unsigned int> > stateObservationProperty_;
+        /** \brief The roadmap vertex of every observation graph vertex that was added for a FIRM node */
+        std::unordered_map<Vertex, Vertex> roadmapVertices_;
+
+        /** \brief Stores the list of ids of landmarks that a vertex in the graph can see, indexed by vertex*/
+        std::vector<std::vector<unsigned int> > stateObservationProperty_;
+
+        /** \brief Inverted index from a landmark id to the vertices that see it */
+        std::unordered_map<unsigned int, std::vector<Vertex> > landmarkObservers_;
+
+        /** \brief Vertices that do not see any landmark, these all overlap with each other */
+        std::vector<Vertex> blindVertices_;
+
+        /** \brief Observation graph vertices bucketed in a planar grid with cells as wide as the neighborhood range */
+        std::unordered_map<long long, std::vector<Vertex> > vertexGrid_;
 
         /** \brief Mutex to guard access to the Graph member (g_) */
         mutable boost::mutex                                   graphMutex_;
@@ -40,6 +40,7 @@
 #include "ompl/base/ValidStateSampler.h"
 #include "ompl/base/StateSampler.h"
 #include "SpaceInformation/SpaceInformation.h"
+#include "Utils/ObservabilityMap.h"
 
 /* The state validity checker function should check collision and observability */
 
@@ -86,6 +87,13 @@ class GaussianValidBeliefSampler : public ompl::base::ValidStateSampler
         motionModel_ = mm;
     }
 
+    /** \brief Draw the free side of most Gaussian pairs from the valid and observable cells of the map,
+        the accepted sample still gets the exact check */
+    void setObservabilityMap(const std::shared_ptr<const firm::ObservabilityMap> &map)
+    {
+        observabilityMap_ = map;
+    }
+
 
   protected:
     /** brief Checks if the sample is observable i.e. If it can observe sufficient landmarks */
@@ -102,6 +110,12 @@ class GaussianValidBeliefSampler : public ompl::base::ValidStateSampler
 
     /** \brief A pointer to the motion model of the system */
     ObservationModelPointer observationModel_;
+
+    /** \brief Optional raster the free side of the pairs is drawn from */
+    std::shared_ptr<const firm::ObservabilityMap> observabilityMap_;
+
+    /** \brief Random numbers for drawing from the map */
+    ompl::RNG rng_;
 };
 
 #endif
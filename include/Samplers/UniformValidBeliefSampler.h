@@ -40,6 +40,7 @@
 #include "ompl/base/ValidStateSampler.h"
 #include "ompl/base/StateSampler.h"
 #include "SpaceInformation/SpaceInformation.h"
+#include "Utils/ObservabilityMap.h"
 
 /*
 Samples states in the belief space uniformly.
@@ -63,6 +64,13 @@ class UniformValidBeliefSampler : public ompl::base::ValidStateSampler
     virtual bool sample(State *state);
     virtual bool sampleNear(State *state, const State *near, const double distance);
 
+    /** \brief Draw most candidates from the valid and observable cells of the map instead of the whole space,
+        every candidate still gets the exact check */
+    void setObservabilityMap(const std::shared_ptr<const firm::ObservabilityMap> &map)
+    {
+        observabilityMap_ = map;
+    }
+
     /**
     void setObservationModel(ObservationModelPointer om)
     {
@@ -81,6 +89,12 @@ class UniformValidBeliefSampler : public ompl::base::ValidStateSampler
     */
     bool isObservable(ompl::base::State *state);
 
+    /** \brief Optional raster the candidates are drawn from */
+    std::shared_ptr<const firm::ObservabilityMap> observabilityMap_;
+
+    /** \brief Random numbers for drawing from the map */
+    ompl::RNG rng_;
+
     //ActuationSystemPointer actuationSystem_;
     //ObservationModelPointer observationModel_;
 };
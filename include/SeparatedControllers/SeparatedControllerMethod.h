@@ -71,6 +71,10 @@ class SeparatedControllerMethod
 
     virtual ompl::control::Control* generateFeedbackControl(const ompl::base::State *state, const size_t& _t = 0) = 0;
 
+    /** \brief Called once a control returned by generateFeedbackControl has been applied. Controllers that allocate a
+        fresh control per call release it here; controllers that hand out controls they still own keep the default. */
+    virtual void releaseFeedbackControl(ompl::control::Control *control) {}
+
     //void SetReachedFlag(bool _flag){m_reachedFlag = _flag;}
 
   protected:
@@ -59,6 +59,12 @@ class StationaryLQR : public SeparatedControllerMethod
     ~StationaryLQR() {}
 
   ompl::control::Control* generateFeedbackControl(const ompl::base::State *state, const size_t& Ts = 0) ;
+
+  /** \brief The feedback control is allocated per call, hand it back to the motion model. */
+  void releaseFeedbackControl(ompl::control::Control *control)
+  {
+      motionModel_->freeControl(control);
+  }
   
   private:
 
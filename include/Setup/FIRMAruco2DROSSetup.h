@@ -42,7 +42,9 @@
 #include <tinyxml.h>
 #include "Planner/FIRM.h"
 #include "edplompl.h"
+#ifndef HEADLESS
 #include "Visualization/Window.h"
+#endif
 #include "Visualization/Visualizer.h"
 
 /** \brief Wrapper for ompl::app::RigidBodyPlanning that plans for rigid bodies in SE2BeliefSpace using FIRM */
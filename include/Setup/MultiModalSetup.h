@@ -113,6 +113,8 @@ public:
         goal_  = siF_->allocState();
 
         setup_ = false;
+
+        roundBudget_ = 0;
     }
 
     virtual ~MultiModalSetup(void)
@@ -180,7 +182,10 @@ public:
 
             // Create an FCL state validity checker and assign to space information
             const ompl::base::StateValidityCheckerPtr &fclSVC = this->allocStateValidityChecker(siF_, getGeometricStateExtractor(), false);
-            siF_->setStateValidityChecker(fclSVC);
+            siF_->setStateValidityChecker(validityCheckerSetup_.allocValidityChecker(siF_, fclSVC));
+
+            // bisects motions and strides over free space when the checker is an ESDF
+            siF_->setMotionValidator(std::make_shared<HierarchicalMotionValidator>(siF_));
 
             siF_->setStateValidityCheckingResolution(0.005);
 
@@ -221,6 +226,8 @@ public:
 
             policyGenerator_->setBeliefTargetStates(targetStates_);
 
+            policyGenerator_->setPolicyGenerationBudget(roundBudget_);
+
             siF_->setTrueState(start_);
 
             setup_ = true;
@@ -282,7 +289,8 @@ public:
 
                 //std::cout<<"Clearance :"<<siF_->getStateValidityChecker()->clearance(currentTrueState)<<std::endl;
 
-                boost::this_thread::sleep(boost::posix_time::milliseconds(20));
+                if(Visualizer::isEnabled())
+                    boost::this_thread::sleep(boost::posix_time::milliseconds(20));
             }
         }
 
@@ -401,6 +409,16 @@ protected:
 
         planningTime_ = time;
 
+        // optional wall clock budget for each NBM3P planning round
+        double roundBudget = 0;
+
+        // spelled as in the <NBM3P> element of the FIRM setup
+        if(itemElement->QueryDoubleAttribute("roundbudget", &roundBudget) == TIXML_SUCCESS && roundBudget >= 0)
+            roundBudget_ = roundBudget;
+
+        // optional validity checker, FCL unless a signed distance field is requested, and scheduled obstacles
+        validityCheckerSetup_.load(node);
+
         this->loadStartBeliefs();
 
         this->loadTargets();
@@ -538,6 +556,12 @@ private:
 
     double planningTime_;
 
+    /** \brief Wall clock budget of each NBM3P planning round in seconds, 0 for none */
+    double roundBudget_;
+
+    /** \brief Validity checker options read from the setup file */
+    ValidityCheckerSetup validityCheckerSetup_;
+
     bool setup_;
 
     std::vector<ompl::base::State*> beliefStates_;
@@ -44,7 +44,9 @@
 #include <tinyxml.h>
 #include "Planner/FIRM.h"
 #include "edplompl.h"
+#ifndef HEADLESS
 #include "Visualization/Window.h"
+#endif
 #include "Visualization/Visualizer.h"
 
 /** \brief Wrapper for ompl::app::RigidBodyPlanning that plans for rigid bodies in SE2BeliefSpace for a point robot with known heading using FIRM */
@@ -174,7 +176,10 @@ public:
 
             // Create an FCL state validity checker and assign to space information
             const ompl::base::StateValidityCheckerPtr &fclSVC = this->allocStateValidityChecker(siF_, getGeometricStateExtractor(), false);
-            siF_->setStateValidityChecker(fclSVC);
+            siF_->setStateValidityChecker(validityCheckerSetup_.allocValidityChecker(siF_, fclSVC));
+
+            // bisects motions and strides over free space when the checker is an ESDF
+            siF_->setMotionValidator(std::make_shared<HierarchicalMotionValidator>(siF_));
 
             // provide the observation model to the space
             ObservationModelMethod::ObservationModelPointer om(new HeadingBeaconObservationModel(siF_, pathToSetupFile_.c_str()));
@@ -296,10 +301,11 @@ public:
             if(!this->setEnvironmentMesh(dynObstList_[obindx]))
                 OMPL_ERROR("Couldn't set mesh with path: %s",dynObstList_[obindx]);
             
-            const ompl::base::StateValidityCheckerPtr &svc = std::make_shared<ompl::app::FCLStateValidityChecker<ompl::app::Motion_2D>>(siF_,  getGeometrySpecification(), getGeometricStateExtractor(), false);
+            const ompl::base::StateValidityCheckerPtr &fclSVC = std::make_shared<ompl::app::FCLStateValidityChecker<ompl::app::Motion_2D>>(siF_,  getGeometrySpecification(), getGeometricStateExtractor(), false);
 
-            siF_->setStateValidityChecker(svc);
+            const ompl::base::StateValidityCheckerPtr &svc = validityCheckerSetup_.allocValidityChecker(siF_, fclSVC);
 
+            // installs svc on the space once it has been compared with the previous checker
             planner_->as<FIRM>()->updateCollisionChecker(svc);
         }
 
@@ -557,6 +563,9 @@ protected:
 
         planningTime_ = time;
 
+        // optional validity checker, FCL unless a signed distance field is requested, and scheduled obstacles
+        validityCheckerSetup_.load(node);
+
         // read planning time
         child  = node->FirstChild("FIRMNodes");
         assert( child );
@@ -649,5 +658,8 @@ private:
     std::vector<string> dynObstList_;
 
     int plannerMethod_;
+
+    /** \brief Validity checker options read from the setup file */
+    ValidityCheckerSetup validityCheckerSetup_;
 };
 #endif
@@ -42,6 +42,7 @@
 #include "MotionModels/MotionModelMethod.h"
 #include "ObservationModels/ObservationModelMethod.h"
 
+class SpatioTemporalValidityChecker;
 
 /**
 The FIRMSpace information class is a derivative of the control::spaceinformation
@@ -69,6 +70,9 @@ namespace firm
                 belief_    = this->allocState();
                 showRobot_ = true;
                 logVelocity_ = false;
+                simulationTime_ = 0;
+                timedChecker_ = NULL;
+                timedCheckerBase_ = NULL;
             }
 
 
@@ -86,6 +90,12 @@ namespace firm
                 motionModel_ = mm;
             }
 
+            /** \brief Set the validity checker and remember whether it is a SpatioTemporalValidityChecker, so
+                isValidAtTime does not have to find out on every call */
+            void setStateValidityChecker(const ompl::base::StateValidityCheckerPtr &svc);
+
+            using ompl::control::SpaceInformation::setStateValidityChecker;
+
             void setBelief(const ompl::base::State *state);
 
             void setTrueState(const ompl::base::State *state);
@@ -105,10 +115,25 @@ namespace firm
                 this->copyState(state, trueState_);
             }
 
-            /** \brief Checks whether the true system state is in valid or not*/
+            /** \brief Checks whether the true system state is in valid or not at the current simulation time*/
             bool checkTrueStateValidity(void)
             {
-                return this->isValid(trueState_);
+                return this->isValidAtTime(trueState_, simulationTime_);
+            }
+
+            /** \brief Checks the state against the obstacles at the given time (seconds) if the validity checker is a
+                SpatioTemporalValidityChecker, otherwise same as isValid */
+            bool isValidAtTime(const ompl::base::State *state, double time) const;
+
+            /** \brief Set the clock of the simulated robot, applyControl advances it by one motion model time step */
+            void setSimulationTime(double time)
+            {
+                simulationTime_ = time;
+            }
+
+            double getSimulationTime(void) const
+            {
+                return simulationTime_;
             }
 
             virtual void applyControl(const ompl::control::Control *control, bool withNoise = true);
@@ -153,6 +178,15 @@ namespace firm
             /** \brief Storage for velocity log v, w*/
             std::vector<std::pair<double,double> > velocityLog_;
 
+            /** \brief Time (seconds) of the true state, used to check it against scheduled obstacles */
+            double simulationTime_;
+
+            /** \brief The validity checker as a SpatioTemporalValidityChecker, NULL if it is not one */
+            const SpatioTemporalValidityChecker *timedChecker_;
+
+            /** \brief The checker timedChecker_ was found for, a checker set through the base class is looked up again */
+            const ompl::base::StateValidityChecker *timedCheckerBase_;
+
 
 
     };
@@ -181,8 +181,10 @@ class SE2BeliefSpace : public ompl::base::CompoundStateSpace
             return as<RealVectorStateSpace>(0)->getBounds();
         }
 
+        /** \brief Allocate a belief state. States released on the calling thread are reused before new memory is requested. */
         virtual State* allocState(void) const;
         virtual void copyState(State *destination,const State *source) const;
+        /** \brief Release a belief state. The state is kept on a per-thread list for reuse by allocState. */
         virtual void freeState(State *state) const;
 
         //virtual void registerProjections(void);
@@ -97,6 +97,40 @@ bool isTheStateValid(const ob::State *state)
 
     return true;//om->isStateObservable(state);
 }
+
+void TestMatchLandmarksDuplicateIds()
+{
+    // [ID, Range, Bearing, Orientation] per landmark, the mode predicts id 7 twice while the robot sees it once
+    colvec trueObservation(4);
+    trueObservation<<7<<1.0<<0.1<<0.0<<endr;
+
+    colvec predictedObservation(12);
+    predictedObservation<<7<<1.5<<0.2<<0.0
+                        <<3<<2.0<<0.0<<0.0
+                        <<7<<4.0<<0.3<<0.0<<endr;
+
+    NBM3P::LandmarkIndex predictedLandmarks;
+    colvec innov;
+
+    unsigned int numMatched = NBM3P::matchLandmarks(predictedObservation, trueObservation, predictedLandmarks, innov);
+
+    // the landmark that is seen is paired once, with the first prediction of its id
+    assert(numMatched == 1);
+    assert(fabs(innov(0) - (1.0 - 1.5)) < 1e-9);
+    assert(fabs(innov(1) - (0.1 - 0.2)) < 1e-9);
+
+    // the robot sees ids 7 and 3, the mode only predicts 7
+    numMatched = NBM3P::matchLandmarks(trueObservation, predictedObservation.subvec(0,7), predictedLandmarks, innov);
+
+    assert(numMatched == 1);
+
+    // the robot sees id 7 twice and the mode predicts it once, both sightings pair with that prediction
+    numMatched = NBM3P::matchLandmarks(trueObservation, join_cols(trueObservation, trueObservation), predictedLandmarks, innov);
+
+    assert(numMatched == 2 && innov.n_rows >= 4);
+
+    cout<<"Landmark matching passed tests"<<endl;
+}
 /*
 void TestBeliefStateSampler()
 {
@@ -0,0 +1,139 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2014, Texas A&M University
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Texas A&M University nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+
+
+/* Authors: Saurav Agarwal */
+
+#ifndef ALLOCATION_SCOPE_H_
+#define ALLOCATION_SCOPE_H_
+
+#include <vector>
+#include <boost/noncopyable.hpp>
+#include "SpaceInformation/SpaceInformation.h"
+
+namespace firm
+{
+    /**
+    @par Description
+    An AllocationScope owns the temporary belief states and controls that are needed while simulating
+    an edge, a Monte Carlo particle or a rollout, and hands all of them back at once when it goes out of
+    scope. Together with the per-thread reuse in SE2BeliefSpace and MotionModelMethod this keeps the
+    Monte Carlo loops from going to the heap (or leaking) on every step.
+    */
+    class AllocationScope : private boost::noncopyable
+    {
+
+        public:
+
+            /** \brief Constructor */
+            AllocationScope(const firm::SpaceInformation::SpaceInformationPtr &si) : si_(si)
+            {
+            }
+
+            /** \brief Destructor, releases everything allocated in this scope */
+            ~AllocationScope()
+            {
+                release();
+            }
+
+            /** \brief Allocate a state that lives until the scope ends */
+            ompl::base::State* allocState()
+            {
+                ompl::base::State *state = si_->allocState();
+                states_.push_back(state);
+                return state;
+            }
+
+            /** \brief Clone a state, the clone lives until the scope ends */
+            ompl::base::State* cloneState(const ompl::base::State *source)
+            {
+                ompl::base::State *state = allocState();
+                si_->copyState(state, source);
+                return state;
+            }
+
+            /** \brief Allocate a control that lives until the scope ends */
+            ompl::control::Control* allocControl()
+            {
+                ompl::control::Control *control = si_->getMotionModel()->allocControl();
+                controls_.push_back(control);
+                return control;
+            }
+
+            /** \brief Take ownership of a state allocated elsewhere */
+            void adopt(ompl::base::State *state)
+            {
+                states_.push_back(state);
+            }
+
+            /** \brief Take ownership of a control allocated elsewhere */
+            void adopt(ompl::control::Control *control)
+            {
+                controls_.push_back(control);
+            }
+
+            /** \brief Take ownership of a sequence of controls, e.g. an open loop policy */
+            void adopt(const std::vector<ompl::control::Control*> &controls)
+            {
+                controls_.insert(controls_.end(), controls.begin(), controls.end());
+            }
+
+            /** \brief Release everything owned by the scope now */
+            void release()
+            {
+                for(unsigned int i = 0; i < states_.size(); i++)
+                {
+                    si_->freeState(states_[i]);
+                }
+
+                states_.clear();
+
+                si_->getMotionModel()->freeControls(controls_);
+            }
+
+        private:
+
+            /** \brief The space the states and controls belong to */
+            firm::SpaceInformation::SpaceInformationPtr si_;
+
+            /** \brief States owned by this scope */
+            std::vector<ompl::base::State*> states_;
+
+            /** \brief Controls owned by this scope */
+            std::vector<ompl::control::Control*> controls_;
+
+    };
+}
+
+#endif
@@ -0,0 +1,115 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2014, Texas A&M University
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Texas A&M University nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+
+/* Authors: Saurav Agarwal */
+
+#ifndef EDGE_GRID_H_
+#define EDGE_GRID_H_
+
+#include <cstddef>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace firm
+{
+    /**
+    @par Description
+    A uniform grid over the x-y plane in which every roadmap edge is filed under the cells its swept bounding box
+    overlaps. Given a region where the obstacles changed, the edges that can pass through it are found without
+    visiting the rest of the roadmap.
+
+    Edges are stored as (source, target) vertex pairs. Removing an edge from the roadmap does not remove it from
+    the grid, so callers have to check that a returned edge still exists, or call remove with the box the edge was
+    inserted with, e.g. before its vertex id is reused.
+    */
+    class EdgeGrid
+    {
+
+        public:
+
+            typedef std::pair<std::size_t, std::size_t> VertexPair;
+
+            /** \brief Constructor, cellSize is the side of a grid cell in meters. */
+            EdgeGrid(const double cellSize);
+
+            /** \brief File the edge from a to b under every cell overlapping the box [minX, maxX] x [minY, maxY]. */
+            void insert(const std::size_t a, const std::size_t b, const double minX, const double minY, const double maxX, const double maxY);
+
+            /** \brief Take the edge from a to b out of every cell overlapping the box it was inserted with. */
+            void remove(const std::size_t a, const std::size_t b, const double minX, const double minY, const double maxX, const double maxY);
+
+            /** \brief The edges filed under any cell overlapping the box, sorted and without duplicates. */
+            void query(const double minX, const double minY, const double maxX, const double maxY, std::vector<VertexPair> &edges) const;
+
+            /** \brief Call visit(minX, minY, maxX, maxY, edges) for every cell that has edges filed under it. */
+            template <class Visitor>
+            void forEachCell(Visitor visit) const
+            {
+                for(std::unordered_map<long long, std::vector<VertexPair> >::const_iterator cell = cells_.begin(); cell != cells_.end(); ++cell)
+                {
+                    const int cellX = (int)(cell->first >> 32);
+                    const int cellY = (int)(unsigned int)cell->first;
+
+                    visit(cellX*cellSize_, cellY*cellSize_, (cellX + 1)*cellSize_, (cellY + 1)*cellSize_, cell->second);
+                }
+            }
+
+            /** \brief Forget every edge. */
+            void clear()
+            {
+                cells_.clear();
+                numEdges_ = 0;
+            }
+
+            /** \brief True if no edge was inserted. */
+            bool empty() const
+            {
+                return numEdges_ == 0;
+            }
+
+        private:
+
+            /** \brief Key of the grid cell (cellX, cellY). */
+            static long long cellKey(const int cellX, const int cellY);
+
+            double cellSize_;
+
+            std::size_t numEdges_;
+
+            std::unordered_map<long long, std::vector<VertexPair> > cells_;
+    };
+}
+
+#endif
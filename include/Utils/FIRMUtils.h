@@ -37,6 +37,7 @@
 
 #include "Weight/FIRMWeight.h"
 #include "Spaces/SE2BeliefSpace.h"
+#include <boost/function.hpp>
 
 /** \brief A class containing utility functions used commonly*/
 class FIRMUtils
@@ -52,8 +53,8 @@ class FIRMUtils
         /** \brief Generates a random number within the give range */
         static int generateRandomIntegerInRange(const int floor, const int ceiling);
 
-        /** \brief Save the FIRM graph to an XML file */
-        static void writeFIRMGraphToXML(const std::vector<std::pair<int,std::pair<arma::colvec,arma::mat> > > nodes, const std::vector<std::pair<std::pair<int,int>,FIRMWeight> > edgeWeights);
+        /** \brief Save the FIRM graph to an XML file, a time stamped file in the working directory is used if no path is given */
+        static void writeFIRMGraphToXML(const std::vector<std::pair<int,std::pair<arma::colvec,arma::mat> > > nodes, const std::vector<std::pair<std::pair<int,int>,FIRMWeight> > edgeWeights, const std::string &pathToXML = "");
 
         /** \brief Reads the Graph properties from an XML file */
         static bool readFIRMGraphFromXML(const std::string &pathToXML,std::vector<std::pair<int, arma::colvec> > &FIRMNodePosList, std::vector<std::pair<int, arma::mat> > &FIRMNodeCovarianceList, std::vector<std::pair<std::pair<int,int>,FIRMWeight> > &edgeWeights);
@@ -63,6 +64,13 @@ class FIRMUtils
 
         /** \brief radians to degree */
         static double radian2Degree(double rads);
+
+        /** \brief Calls job(i) for every i in [0, numJobs) on a pool of worker threads and blocks until all jobs are done.
+            Jobs are handed out one index at a time from a shared counter, so they must not depend on each other. If
+            maxThreads is 0, one worker per hardware thread is used. The pool threads persist between calls. If a job
+            throws, no further jobs are started and the first exception is rethrown once the running jobs have finished.
+            A parallelFor called from inside a job runs serially on that job's thread.*/
+        static void parallelFor(const unsigned int numJobs, const boost::function<void (unsigned int)> &job, unsigned int maxThreads = 0);
 };
 
 #endif
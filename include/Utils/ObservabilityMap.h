@@ -0,0 +1,120 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2014, Texas A&M University
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Texas A&M University nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+
+/* Authors: Saurav Agarwal */
+
+#ifndef OBSERVABILITY_MAP_H_
+#define OBSERVABILITY_MAP_H_
+
+#include <vector>
+#include <ompl/util/RandomNumbers.h>
+#include "SpaceInformation/SpaceInformation.h"
+
+namespace firm
+{
+    /**
+    @par Description
+    A raster over the x-y bounds of the state space that records, for every cell and every heading sector, whether
+    a pose in the cell facing the middle of the sector is both valid and observable. A few poses are probed per
+    cell (the center and four points around it) and the sector passes if any of them does, so a passage narrower
+    than a cell is not lost because it misses the center. It is built once (and again when the obstacles change)
+    so that the belief samplers can draw candidates from the cells that passed instead of rejecting most uniform
+    samples in a cluttered map.
+
+    The raster is an approximation: a sample drawn from a cell is only accepted after the exact validity and
+    observability check, isValidAndObservable. The samplers still take a share of their draws uniformly from the
+    whole space (see drawFromMap), so poses the probes missed keep a nonzero probability.
+    */
+    class ObservabilityMap
+    {
+
+        public:
+
+            /** \brief Constructor, resolution is the cell size in meters and numHeadings the number of heading
+                sectors (at most 8) the full turn is split into. The map is empty until it is built. */
+            ObservabilityMap(const SpaceInformation::SpaceInformationPtr &si, const double resolution, const unsigned int numHeadings);
+
+            /** \brief Check every cell and heading sector against the current validity checker and observation model. */
+            void build();
+
+            /** \brief Draw a pose uniformly from a cell that passed, with the heading drawn from one of its passing sectors.
+                Returns false if no cell passed. */
+            bool sample(ompl::RNG &rng, ompl::base::State *state) const;
+
+            /** \brief Same as sample but restricted to the cells within distance of near (per axis). */
+            bool sampleNear(ompl::RNG &rng, ompl::base::State *state, const ompl::base::State *near, const double distance) const;
+
+            /** \brief Decides where the next draw of a sampler comes from: true to draw from the map, false for the
+                share of the draws that are taken uniformly from the whole space. Always false if the map is empty. */
+            bool drawFromMap(ompl::RNG &rng) const;
+
+            /** \brief The exact check that a drawn sample has to pass. */
+            bool isValidAndObservable(const ompl::base::State *state) const;
+
+            /** \brief True until built, or if no cell passed. */
+            bool empty() const
+            {
+                return goodCells_.empty();
+            }
+
+            /** \brief Number of cells with at least one passing heading sector. */
+            std::size_t size() const
+            {
+                return goodCells_.size();
+            }
+
+        private:
+
+            /** \brief Fill state with a pose drawn from the given cell */
+            void sampleInCell(ompl::RNG &rng, const unsigned int cell, ompl::base::State *state) const;
+
+            SpaceInformation::SpaceInformationPtr si_;
+
+            double resolution_;
+
+            unsigned int numHeadings_;
+
+            double originX_, originY_;
+
+            int sizeX_, sizeY_;
+
+            /** \brief One bit per heading sector for every cell, row major */
+            std::vector<unsigned char> headings_;
+
+            /** \brief Indices into headings_ of the cells with at least one bit set */
+            std::vector<unsigned int> goodCells_;
+    };
+}
+
+#endif
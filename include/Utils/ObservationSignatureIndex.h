@@ -0,0 +1,156 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2014, Texas A&M University
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Texas A&M University nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+
+/* Authors: Saurav Agarwal */
+
+#ifndef OBSERVATION_SIGNATURE_INDEX_H_
+#define OBSERVATION_SIGNATURE_INDEX_H_
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "SpaceInformation/SpaceInformation.h"
+#include "armadillo"
+
+namespace firm
+{
+    /**
+    @par Description
+    An offline index from what the robot sees to where it could be, used to seed the modes when the robot is
+    kidnapped. The environment is gridded once (the same grid NBM3P used to sample from); every valid pose is
+    stored together with the noise free observation it produces. For each landmark seen from a pose, the pose is
+    filed under the key (landmark id, range bin, bearing bin).
+
+    A query takes the robot's observation and, for each landmark in it, collects the poses filed under that
+    landmark in the same or an adjacent range/bearing bin, and counts how many of the observed landmarks each pose
+    agrees with. The candidates are the poses that agree with all of them, or all but one: a landmark at the edge of
+    the camera range or field of view may be seen from the true pose but not from the nearest indexed one. Poses that
+    agree with more landmarks come first. The query is a pre-filter: the candidates are still weighted against the
+    observation by the planner, and an empty result means the caller should fall back to sampling the full grid.
+
+    A saved index is only reused if it was built with the same bin sizes and grid, and for the same landmarks and
+    obstacles. The latter are summarized by a fingerprint of what the robot sees (and whether it is valid) at every
+    grid point at zero heading, which is cheap compared to indexing every heading.
+
+    @par File format
+    \code
+    FIRM_OBSERVATION_SIGNATURES <rangeBinSize> <bearingBinSize> <gridSize> <rotationSpacing> <fingerprint> <numPoses>
+    P <x> <y> <yaw> <numLandmarks> <id_1> <rangeBin_1> <bearingBin_1> .. <id_n> <rangeBin_n> <bearingBin_n>
+    \endcode
+    */
+    class ObservationSignatureIndex
+    {
+
+        public:
+
+            /** \brief Constructor, the index will grid the environment with the given spacing (meters) and heading
+                spacing (radians). It is empty until it is built or loaded. */
+            ObservationSignatureIndex(const double rangeBinSize, const double bearingBinSize, const double gridSize, const double rotationSpacing);
+
+            /** \brief Grids the state space bounds and indexes the observation seen from every valid pose. */
+            void build(const SpaceInformation::SpaceInformationPtr &si);
+
+            /** \brief Loads an index written by save. Fails if the file is missing, was built with other bin sizes or
+                grid, or its fingerprint does not match the landmarks and obstacles of si. */
+            bool load(const std::string &pathToFile, const SpaceInformation::SpaceInformationPtr &si);
+
+            /** \brief Writes the index to the given file. */
+            bool save(const std::string &pathToFile) const;
+
+            /** \brief Returns the (x, y, yaw) of every indexed pose consistent with the given observation, best matches first. */
+            void query(const arma::colvec &observation, std::vector<arma::colvec> &candidates) const;
+
+            /** \brief True until the index is built or loaded. */
+            bool empty() const
+            {
+                return poses_.empty();
+            }
+
+            /** \brief Number of indexed poses. */
+            std::size_t size() const
+            {
+                return poses_.size();
+            }
+
+        private:
+
+            /** \brief A landmark as seen from an indexed pose. */
+            struct LandmarkBin
+            {
+                int id;
+
+                int rangeBin;
+
+                int bearingBin;
+            };
+
+            /** \brief An indexed pose and the landmarks it sees. */
+            struct Pose
+            {
+                double x, y, yaw;
+
+                std::vector<LandmarkBin> landmarks;
+            };
+
+            /** \brief Quantize the landmarks in an observation. */
+            void binObservation(const arma::colvec &observation, std::vector<LandmarkBin> &landmarks) const;
+
+            /** \brief Rebuild the landmark bins to poses map from poses_. */
+            void buildBins();
+
+            /** \brief Key of the (landmark id, range bin, bearing bin) cell. */
+            static long long binKey(const int id, const int rangeBin, const int bearingBin);
+
+            /** \brief Hash of the bounds, and of the validity and noise free observation at every grid point at zero heading. */
+            unsigned long long fingerprint(const SpaceInformation::SpaceInformationPtr &si) const;
+
+            double rangeBinSize_;
+
+            double bearingBinSize_;
+
+            double gridSize_;
+
+            double rotationSpacing_;
+
+            /** \brief Fingerprint of the environment the index was built for */
+            unsigned long long fingerprint_;
+
+            std::vector<Pose> poses_;
+
+            /** \brief Indices into poses_ of the poses that see a landmark in a given bin, sorted. */
+            std::unordered_map<long long, std::vector<unsigned int> > bins_;
+    };
+}
+
+#endif
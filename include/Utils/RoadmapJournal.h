@@ -0,0 +1,175 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2014, Texas A&M University
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Texas A&M University nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+
+/* Authors: Saurav Agarwal */
+
+#ifndef ROADMAP_JOURNAL_H_
+#define ROADMAP_JOURNAL_H_
+
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <boost/noncopyable.hpp>
+#include <boost/thread.hpp>
+#include "Weight/FIRMWeight.h"
+#include "armadillo"
+
+namespace firm
+{
+    /**
+    @par Description
+    An append-only log of the changes made to a FIRM roadmap while it is being built. Every node insertion,
+    edge insertion and edge weight update is written as a single line, so a crash during a long roadmap
+    construction loses at most the records that were still queued. Records are formatted on the caller's
+    thread and written and flushed by a background writer, so an insertion costs O(1) on the planner side.
+
+    The journal is periodically compacted: the full roadmap is saved as an XML snapshot (the same format as
+    FIRM::savePlannerData) and the journal restarts empty on top of it. The first line of the journal names
+    the snapshot generation it applies to, which keeps replay consistent if the process dies mid-compaction.
+
+    @par File format
+    \code
+    FIRM_ROADMAP_JOURNAL <generation>
+    N <id> <dim> <x_1 .. x_dim> <cov_11 .. cov_dimdim>
+    E <startVertexID> <endVertexID> <cost> <successProb>
+    W <startVertexID> <endVertexID> <cost> <successProb>
+    \endcode
+    */
+    class RoadmapJournal : private boost::noncopyable
+    {
+
+        public:
+
+            typedef std::vector<std::pair<int,std::pair<arma::colvec,arma::mat> > > NodeList;
+
+            typedef std::vector<std::pair<std::pair<int,int>,FIRMWeight> > EdgeList;
+
+            /** \brief Opens the journal at the given path for appending, creating it if it does not exist,
+                and starts the writer thread. */
+            RoadmapJournal(const std::string &pathToJournal);
+
+            /** \brief Writes out all pending records and stops the writer thread. */
+            ~RoadmapJournal();
+
+            /** \brief Records the insertion of a node with the given mean and covariance. */
+            void appendNode(const int id, const arma::colvec &x, const arma::mat &cov);
+
+            /** \brief Records the insertion of the edge a->b. */
+            void appendEdge(const int a, const int b, const FIRMWeight &w);
+
+            /** \brief Records a change to the weight of the edge a->b. */
+            void appendEdgeWeight(const int a, const int b, const FIRMWeight &w);
+
+            /** \brief Returns true once enough records have been appended since the last compaction. */
+            bool needsCompaction() const;
+
+            /** \brief Replaces the journal with a snapshot of the given roadmap. The snapshot is written by the
+                writer thread after all records appended before this call, so the caller must pass the roadmap
+                as it is at the time of the call. */
+            void compact(const NodeList &nodes, const EdgeList &edges);
+
+            /** \brief Blocks until every record appended so far is on disk. */
+            void flush();
+
+            /** \brief The path to the journal file. */
+            const std::string& getPath() const
+            {
+                return path_;
+            }
+
+            /** \brief Checks whether the file at the given path is a roadmap journal. */
+            static bool isJournal(const std::string &pathToFile);
+
+            /** \brief Rebuilds a roadmap from its latest snapshot and the journal on top of it. The output has the
+                same layout as FIRMUtils::readFIRMGraphFromXML. A truncated last record (e.g. from a crash) is ignored. */
+            static bool replay(const std::string &pathToJournal, std::vector<std::pair<int, arma::colvec> > &nodePosList,
+                std::vector<std::pair<int, arma::mat> > &nodeCovarianceList, EdgeList &edgeWeights);
+
+        private:
+
+            /** \brief A pending write, either a single journal record or a compaction. */
+            struct Job
+            {
+                std::string record;
+
+                std::shared_ptr<const std::pair<NodeList, EdgeList> > snapshot;
+            };
+
+            /** \brief Queues a job for the writer thread. */
+            void enqueue(Job &job);
+
+            /** \brief Writer thread, drains the queue in batches and flushes the file after each batch. */
+            void writerLoop();
+
+            /** \brief Writes a snapshot and restarts the journal on top of it, called on the writer thread. */
+            void writeSnapshot(const NodeList &nodes, const EdgeList &edges);
+
+            /** \brief Path to the snapshot of the given generation. */
+            static std::string snapshotPath(const std::string &pathToJournal, const unsigned int generation);
+
+            /** \brief Reads the generation from the journal header, returns false if the file is not a journal. */
+            static bool readHeader(std::istream &in, unsigned int &generation);
+
+            std::string path_;
+
+            std::ofstream file_;
+
+            /** \brief Snapshot generation the journal currently applies to, only touched by the writer thread. */
+            unsigned int generation_;
+
+            std::deque<Job> pending_;
+
+            /** \brief Number of jobs queued and written so far, flush() waits for them to match. */
+            unsigned long long queuedJobs_;
+
+            unsigned long long writtenJobs_;
+
+            /** \brief Records appended since the last compaction */
+            unsigned int recordsSinceCompaction_;
+
+            bool stop_;
+
+            mutable boost::mutex mutex_;
+
+            boost::condition_variable workAvailable_;
+
+            boost::condition_variable workDone_;
+
+            boost::thread writer_;
+    };
+}
+
+#endif
@@ -0,0 +1,111 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2014, Texas A&M University
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Texas A&M University nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+
+/* Authors: Saurav Agarwal */
+
+#ifndef ESDF_VALIDITY_CHECKER_H_
+#define ESDF_VALIDITY_CHECKER_H_
+
+#include <vector>
+#include "ompl/base/StateValidityChecker.h"
+#include "ompl/base/SpaceInformation.h"
+
+/**
+@par Description
+A validity checker for planar robots backed by a Euclidean signed distance field. The x-y bounds of the state space
+are rasterized once with an exact checker (typically FCL): a cell is occupied unless the clearance at its center
+exceeds the footprint radius plus half the cell diagonal, so every pose in a free cell is collision free at any heading.
+The signed distance to the boundary between free and occupied cells is then computed for every cell with an exact
+distance transform.
+
+isValid and clearance are answered in constant time by interpolating the field. Only states well inside the free
+region are accepted from the field; states in or near occupied cells, and states outside the raster, are passed to the
+exact checker, so the discretization can not accept a colliding state.
+
+\brief Constant time validity and clearance from a precomputed signed distance field
+*/
+class ESDFValidityChecker : public ompl::base::StateValidityChecker
+{
+  public:
+
+    /** \brief Rasterize the state space bounds at the given resolution (meters) using the exact checker, footprintRadius
+        bounds the distance (meters) of any point of the robot from its reference point */
+    ESDFValidityChecker(const ompl::base::SpaceInformationPtr &si, const ompl::base::StateValidityCheckerPtr &exactChecker, const double resolution,
+                        const double footprintRadius);
+
+    virtual bool isValid(const ompl::base::State *state) const;
+
+    /** \brief Signed distance to the nearest (footprint inflated) obstacle, negative in possibly colliding cells */
+    virtual double clearance(const ompl::base::State *state) const;
+
+    /** \brief Radius in x-y around the state within which isValid holds at every heading without asking the exact
+        checker, 0 if the state is near an obstacle boundary or outside the raster. Motion validators use it to
+        skip the states of a motion that are certainly valid. */
+    double freeRadius(const ompl::base::State *state) const;
+
+    /** \brief The checker used to build the field and near obstacle boundaries */
+    const ompl::base::StateValidityCheckerPtr& getExactChecker() const
+    {
+        return exactChecker_;
+    }
+
+  private:
+
+    /** \brief Mark the occupied cells and compute the signed distance of every cell */
+    void build();
+
+    /** \brief Interpolated signed distance at (x, y), false if the point is outside the raster */
+    bool signedDistance(const double x, const double y, double &distance) const;
+
+    /** \brief Squared distance (in cells) of every cell to the nearest cell with isTarget set */
+    void squaredDistanceTo(const std::vector<bool> &isTarget, std::vector<double> &squaredDistance) const;
+
+    /** \brief Exact 1D squared distance transform of f (Felzenszwalb and Huttenlocher) */
+    static void distanceTransform1D(const std::vector<double> &f, std::vector<double> &d, std::vector<int> &v, std::vector<double> &z);
+
+    ompl::base::StateValidityCheckerPtr exactChecker_;
+
+    double resolution_;
+
+    double footprintRadius_;
+
+    double originX_, originY_;
+
+    int sizeX_, sizeY_;
+
+    /** \brief Signed distance in meters at every cell center, row major */
+    std::vector<double> distance_;
+};
+
+#endif
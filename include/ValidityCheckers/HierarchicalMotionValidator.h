@@ -0,0 +1,82 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2014, Texas A&M University
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Texas A&M University nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+
+/* Authors: Saurav Agarwal */
+
+#ifndef HIERARCHICAL_MOTION_VALIDATOR_H_
+#define HIERARCHICAL_MOTION_VALIDATOR_H_
+
+#include "ompl/base/MotionValidator.h"
+#include "ompl/base/SpaceInformation.h"
+
+class ESDFValidityChecker;
+
+/**
+@par Description
+Checks the same states along a motion as ompl's DiscreteMotionValidator, one per StateValidityCheckingResolution,
+but not one after the other. The goal state is checked first, then the motion is bisected breadth first so the
+middle of the motion, the state farthest from the two known valid ones, is tested before its neighbours.
+
+When the validity checker is an ESDFValidityChecker, every tested state also reports how far it is from the nearest
+obstacle boundary; all the states of the motion within that distance are known to be valid and are skipped, so long
+edges through free space cost a handful of lookups. The result is the same as checking every state.
+
+\brief Motion validator that bisects and strides over free space instead of walking the motion
+*/
+class HierarchicalMotionValidator : public ompl::base::MotionValidator
+{
+  public:
+
+    HierarchicalMotionValidator(const ompl::base::SpaceInformationPtr &si) : ompl::base::MotionValidator(si)
+    {
+    }
+
+    virtual bool checkMotion(const ompl::base::State *s1, const ompl::base::State *s2) const;
+
+    virtual bool checkMotion(const ompl::base::State *s1, const ompl::base::State *s2, std::pair<ompl::base::State*, double> &lastValid) const;
+
+  private:
+
+    /** \brief The space's ESDFValidityChecker, also when it is wrapped by a SpatioTemporalValidityChecker, NULL otherwise */
+    const ESDFValidityChecker* getESDF() const;
+
+    /** \brief The number of motion steps on either side of state that are certainly valid, -1 if state itself has to be
+        checked. stepLength is the x-y distance between two consecutive steps. */
+    int freeSteps(const ESDFValidityChecker *esdf, const ompl::base::State *state, const double stepLength, const int numSteps) const;
+
+    /** \brief The x-y distance between two consecutive steps of the motion */
+    double stepLength(const ompl::base::State *s1, const ompl::base::State *s2, const int numSteps) const;
+};
+
+#endif
@@ -0,0 +1,137 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2014, Texas A&M University
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Texas A&M University nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+
+/* Authors: Saurav Agarwal */
+
+#ifndef SPATIO_TEMPORAL_VALIDITY_CHECKER_H_
+#define SPATIO_TEMPORAL_VALIDITY_CHECKER_H_
+
+#include <unordered_map>
+#include <vector>
+#include "ompl/base/StateValidityChecker.h"
+#include "ompl/base/SpaceInformation.h"
+
+/**
+@par Description
+A validity checker for environments with moving obstacles whose motion is known in advance, e.g. forklifts that
+follow a fixed route on a timetable. Each such obstacle is a disc that moves along straight lines between timed
+waypoints. It waits at its first waypoint before the schedule starts and stays at its last waypoint after the
+schedule ends.
+
+The static part of the environment is answered by a wrapped checker (FCL or ESDF). The obstacles are indexed once in
+a space-time grid, with one x-y grid per time bin that lists the obstacles whose swept disc touches each cell during
+that bin. A query at time t then only tests the few obstacles filed under the state's cell and t's bin.
+
+isValid(state) has no notion of time and only checks the static obstacles, so roadmap construction and motion
+validation are unaffected. Code that simulates the robot over time, e.g. edge evaluation and rollout, calls
+isValid(state, t) with the simulated time of each step. Edge costs computed while the roadmap is built are therefore
+tied to the time of the robot at that point, see FIRM::generateEdgeControllerWithCost.
+
+\brief Validity against static obstacles plus discs that move on a known schedule
+*/
+class SpatioTemporalValidityChecker : public ompl::base::StateValidityChecker
+{
+  public:
+
+    /** \brief The obstacle center is at (x, y) at time t (seconds) */
+    struct Waypoint
+    {
+        double x, y, t;
+    };
+
+    /** \brief A disc of the given radius that follows a route of waypoints sorted by time */
+    struct ScheduledObstacle
+    {
+        double radius;
+
+        std::vector<Waypoint> route;
+    };
+
+    /** \brief Index the obstacles against a robot that is approximated by a disc of robotRadius */
+    SpatioTemporalValidityChecker(const ompl::base::SpaceInformationPtr &si, const ompl::base::StateValidityCheckerPtr &staticChecker,
+                                  const std::vector<ScheduledObstacle> &obstacles, const double robotRadius);
+
+    /** \brief Validity against the static obstacles only */
+    virtual bool isValid(const ompl::base::State *state) const;
+
+    /** \brief Validity against the static obstacles and the scheduled obstacles at time t (seconds) */
+    bool isValid(const ompl::base::State *state, const double time) const;
+
+    /** \brief Clearance to the static obstacles */
+    virtual double clearance(const ompl::base::State *state) const;
+
+    /** \brief The checker for the static part of the environment */
+    const ompl::base::StateValidityCheckerPtr& getStaticChecker() const
+    {
+        return staticChecker_;
+    }
+
+    const std::vector<ScheduledObstacle>& getObstacles() const
+    {
+        return obstacles_;
+    }
+
+  private:
+
+    /** \brief File every obstacle under the cells its swept disc touches in every time bin */
+    void build();
+
+    /** \brief The center of the obstacle at time t */
+    static void obstaclePosition(const ScheduledObstacle &obstacle, const double time, double &x, double &y);
+
+    /** \brief The time bin of t, times outside the schedule go to the first or last bin */
+    unsigned int timeBin(const double time) const;
+
+    static long long cellKey(const int x, const int y)
+    {
+        return ((long long)x << 32) ^ (long long)(unsigned int)y;
+    }
+
+    ompl::base::StateValidityCheckerPtr staticChecker_;
+
+    std::vector<ScheduledObstacle> obstacles_;
+
+    double robotRadius_;
+
+    double cellSize_;
+
+    double startTime_;
+
+    double timeResolution_;
+
+    /** \brief For each time bin, the obstacles filed under each x-y cell */
+    std::vector<std::unordered_map<long long, std::vector<unsigned int> > > bins_;
+};
+
+#endif
@@ -0,0 +1,102 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2014, Texas A&M University
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Texas A&M University nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+
+/* Authors: Saurav Agarwal */
+
+#ifndef VALIDITY_CHECKER_SETUP_H_
+#define VALIDITY_CHECKER_SETUP_H_
+
+#include <vector>
+#include <tinyxml.h>
+#include "ompl/base/StateValidityChecker.h"
+#include "ompl/base/SpaceInformation.h"
+#include "ValidityCheckers/SpatioTemporalValidityChecker.h"
+
+/**
+@par Description
+The validity checker options of a planning problem file, shared by the setups. The optional element
+
+\code
+<ValidityChecker type="esdf" resolution="0.05" robotRadius="0.3"/>
+\endcode
+
+under PlanningProblem replaces the FCL checker by an ESDFValidityChecker built over it. type="fcl", or no element,
+keeps FCL. Invalid options are reported and fall back to FCL. The optional element
+
+\code
+<ScheduledObstacles robotRadius="0.3">
+    <Obstacle radius="0.5">
+        <Waypoint x="1" y="1" t="0"/>
+        <Waypoint x="4" y="1" t="10"/>
+    </Obstacle>
+</ScheduledObstacles>
+\endcode
+
+wraps the checker in a SpatioTemporalValidityChecker for the listed moving obstacles.
+
+\brief Reads the validity checker options of a setup file and builds the checker they describe
+*/
+class ValidityCheckerSetup
+{
+  public:
+
+    /** \brief Constructor, checks with FCL until options are loaded */
+    ValidityCheckerSetup();
+
+    /** \brief Read the options from the children of the PlanningProblem element, missing elements reset them to FCL */
+    void load(TiXmlNode *planningProblem);
+
+    /** \brief The FCL checker, or a signed distance field built over it if the setup file asks for one, wrapped in a
+        spatio-temporal checker if the setup file schedules moving obstacles */
+    ompl::base::StateValidityCheckerPtr allocValidityChecker(const ompl::base::SpaceInformationPtr &si, const ompl::base::StateValidityCheckerPtr &fclSVC) const;
+
+  private:
+
+    /** \brief Cell size of the ESDF validity checker in meters, 0 to check with FCL directly */
+    double esdfResolution_;
+
+    /** \brief Distance of the farthest point of the robot from its reference point, bounds the footprint in the ESDF */
+    double esdfRobotRadius_;
+
+    /** \brief Moving obstacles with a known schedule, checked by a SpatioTemporalValidityChecker */
+    std::vector<SpatioTemporalValidityChecker::ScheduledObstacle> scheduledObstacles_;
+
+    /** \brief Radius of the disc that approximates the robot against the scheduled obstacles */
+    double scheduledObstacleRobotRadius_;
+
+    /** \brief Read the optional ScheduledObstacles element, each Obstacle lists the timed Waypoints of its route */
+    void loadScheduledObstacles(TiXmlNode *planningProblem);
+};
+
+#endif
@@ -0,0 +1,149 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2014, Texas A&M University
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Texas A&M University nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+
+/* Authors: Saurav Agarwal */
+
+#ifndef FIRM_OMPL_NULL_VISUALIZER_H
+#define FIRM_OMPL_NULL_VISUALIZER_H
+
+#include <armadillo>
+#include <string>
+#include <vector>
+#include <ompl/geometric/PathGeometric.h>
+#include <omplapp/geometry/RigidBodyGeometry.h>
+#include "SpaceInformation/SpaceInformation.h"
+
+namespace ompl
+{
+    namespace app
+    {
+        class RenderGeometry;
+    }
+}
+
+/**
+@par Description
+The visualizer of headless builds (-DHEADLESS=ON). It has the same static interface as the Qt/OpenGL visualizer so the
+planners and setups compile unchanged, but every call is an empty inline function: nothing is locked, cloned or
+stored, and the compiler removes the calls altogether.
+
+\brief Visualizer that draws nothing, for machines without a display
+*/
+class Visualizer
+{
+
+    public:
+
+        enum VZRStateType
+        {
+            TrueState,
+            BeliefState,
+            GraphNodeState
+        };
+
+        enum VZRDrawingMode
+        {
+            NodeViewMode,
+            FeedbackViewMode,
+            PRMViewMode,
+            RolloutMode,
+            MultiModalMode
+        };
+
+        struct VZRFeedbackEdge
+        {
+            ompl::base::State *source;
+            ompl::base::State *target;
+            double cost;
+        };
+
+        static void setEnabled(bool /*flag*/) {}
+
+        static bool isEnabled() { return false; }
+
+        static void addLandmarks(const std::vector<arma::colvec>& /*landmarks*/) {}
+
+        static void addState(const ompl::base::State * /*state*/) {}
+
+        static void clearStates() {}
+
+        static void addBeliefMode(ompl::base::State * /*state*/) {}
+
+        static void clearBeliefModes() {}
+
+        static void addGraphEdge(const ompl::base::State * /*source*/, const ompl::base::State * /*target*/) {}
+
+        static void addFeedbackEdge(const ompl::base::State * /*source*/, const ompl::base::State * /*target*/, double /*cost*/) {}
+
+        static void addRolloutConnection(const ompl::base::State * /*source*/, const ompl::base::State * /*target*/) {}
+
+        static void addMostLikelyPathEdge(const ompl::base::State * /*source*/, const ompl::base::State * /*target*/) {}
+
+        static void setChosenRolloutConnection(const ompl::base::State * /*source*/, const ompl::base::State * /*target*/) {}
+
+        static void setMode(VZRDrawingMode /*mode*/) {}
+
+        static void ClearFeedbackEdges() {}
+
+        static void clearRolloutConnections() {}
+
+        static void clearMostLikelyPath() {}
+
+        static void addOpenLoopRRTPath(const ompl::geometric::PathGeometric & /*path*/) {}
+
+        static void clearOpenLoopRRTPaths() {}
+
+        static void updateTrueState(const ompl::base::State * /*state*/) {}
+
+        static void updateCurrentBelief(const ompl::base::State * /*state*/) {}
+
+        static void updateSpaceInformation(const firm::SpaceInformation::SpaceInformationPtr & /*si*/) {}
+
+        static void updateRenderer(ompl::app::RenderGeometry * /*renderer*/) {}
+
+        static void updateRenderer(const ompl::app::RigidBodyGeometry & /*rbg*/, const ompl::app::GeometricStateExtractor & /*se*/) {}
+
+        static void clearRobotPath() {}
+
+        static bool saveVideo() { return false; }
+
+        static void doSaveVideo(bool /*flag*/) {}
+
+        /** \brief The robot path is recorded while drawing, so there is none to print */
+        static void printRobotPathToFile(std::string /*path*/)
+        {
+            OMPL_WARN("Visualizer: The robot path is not recorded in headless builds, nothing written");
+        }
+};
+#endif // FIRM_OMPL_NULL_VISUALIZER_H
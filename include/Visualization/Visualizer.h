@@ -37,6 +37,10 @@
 #ifndef FIRM_OMPL_VISUALIZER_H
 #define FIRM_OMPL_VISUALIZER_H
 
+#ifdef HEADLESS
+#include "Visualization/NullVisualizer.h"
+#else
+
 #include <X11/X.h>
 #include <X11/Xlib.h>
 #include <GL/gl.h>
@@ -85,9 +89,23 @@ class Visualizer
             double cost;
         };
 
+        /** \brief Turn the collection of drawing data on or off, when off the planners' calls return at once. Runs
+            without a display (e.g. --headless) turn it off before planning. */
+        static void setEnabled(bool flag)
+        {
+            enabled_ = flag;
+        }
+
+        static bool isEnabled()
+        {
+            return enabled_;
+        }
+
         /** \brief Add the landmarks in the environment */
         static void addLandmarks(const std::vector<arma::colvec>& landmarks)
         {
+            if(!enabled_) return;
+
             boost::mutex::scoped_lock sl(drawMutex_);
             landmarks_.insert(landmarks_.end(), landmarks.begin(), landmarks.end());
         }
@@ -95,6 +113,8 @@ class Visualizer
         /** \brief Add the states i.e. graph nodes to be drawn*/
         static void addState(const ompl::base::State *state)
         {
+            if(!enabled_) return;
+
             boost::mutex::scoped_lock sl(drawMutex_);
             assert(state);
             states_.push_back(si_->cloneState(state));
@@ -111,6 +131,8 @@ class Visualizer
         /** \brief Add state to belief mode list */
         static void addBeliefMode(ompl::base::State *state)
         {
+            if(!enabled_) return;
+
             boost::mutex::scoped_lock sl(drawMutex_);
             assert(state);
             beliefModes_.push_back(si_->cloneState(state));
@@ -126,6 +148,8 @@ class Visualizer
         /** \brief Add a Roadmap Graph edge to the visualization */
         static void addGraphEdge(const ompl::base::State *source, const ompl::base::State *target)
         {
+            if(!enabled_) return;
+
             boost::mutex::scoped_lock sl(drawMutex_);
 
             std::pair<const ompl::base::State*, const ompl::base::State*> edge;
@@ -137,6 +161,8 @@ class Visualizer
 
         static void addFeedbackEdge(const ompl::base::State *source, const ompl::base::State *target, double cost)
         {
+            if(!enabled_) return;
+
             boost::mutex::scoped_lock sl(drawMutex_);
             VZRFeedbackEdge edge;
 
@@ -154,6 +180,8 @@ class Visualizer
         /** \brief Add a rollout connection to the visualization */
         static void addRolloutConnection(const ompl::base::State *source, const ompl::base::State *target)
         {
+            if(!enabled_) return;
+
             boost::mutex::scoped_lock sl(drawMutex_);
 
             std::pair<const ompl::base::State*, const ompl::base::State*> edge;
@@ -166,6 +194,8 @@ class Visualizer
          /** \brief Add a rollout connection to the visualization */
         static void addMostLikelyPathEdge(const ompl::base::State *source, const ompl::base::State *target)
         {
+            if(!enabled_) return;
+
             boost::mutex::scoped_lock sl(drawMutex_);
 
             std::pair<const ompl::base::State*, const ompl::base::State*> edge;
@@ -177,6 +207,8 @@ class Visualizer
 
         static void setChosenRolloutConnection(const ompl::base::State *source, const ompl::base::State *target)
         {
+            if(!enabled_) return;
+
             boost::mutex::scoped_lock sl(drawMutex_);
 
             boost::optional<std::pair<const ompl::base::State*, const ompl::base::State*> > edge(std::make_pair(si_->cloneState(source),si_->cloneState(target)));
@@ -211,6 +243,8 @@ class Visualizer
 
         static void addOpenLoopRRTPath(const ompl::geometric::PathGeometric path)
         {
+            if(!enabled_) return;
+
             boost::mutex::scoped_lock sl(drawMutex_);
             openLoopRRTPaths_.push_back(path);
         }
@@ -224,6 +258,8 @@ class Visualizer
         /** \brief update the robot's true state for drawing */
         static void updateTrueState(const ompl::base::State *state)
         {
+            if(!enabled_) return;
+
             if(si_)
             {
                 boost::mutex::scoped_lock sl(drawMutex_);
@@ -235,6 +271,8 @@ class Visualizer
         /** \brief update the robot's belief for drawing */
         static void updateCurrentBelief(const ompl::base::State *state)
         {
+            if(!enabled_) return;
+
             boost::mutex::scoped_lock sl(drawMutex_);
             if(!currentBelief_) currentBelief_ = si_->allocState();
             si_->copyState(currentBelief_,state);
@@ -385,6 +423,10 @@ class Visualizer
 
         static bool saveVideo_;
 
+        /** \brief False if nothing should be collected for drawing */
+        static bool enabled_;
+
 
 };
+#endif // HEADLESS
 #endif // FIRM_OMPL_VISUALIZER_H
@@ -97,6 +97,10 @@
 
 // Validity checkers
 #include "ValidityCheckers/FIRMValidityChecker.h"
+#include "ValidityCheckers/ESDFValidityChecker.h"
+#include "ValidityCheckers/HierarchicalMotionValidator.h"
+#include "ValidityCheckers/SpatioTemporalValidityChecker.h"
+#include "ValidityCheckers/ValidityCheckerSetup.h"
 
 //Multi-Modal
 #include "Planner/NBM3P.h"
@@ -80,6 +80,21 @@ const LinearSystem& ls, ompl::base::State *updatedState)
 
   mat H = ls.getH();
 
+  // with independent noise the elements are folded in one by one, linear in the number of observations
+  if(ls.hasIndependentObservationNoise())
+  {
+    colvec xEstVec;
+    mat covEst;
+
+    sequentialUpdate(belief->as<StateType>()->getArmaData(), covPred, H, ls.getRVariance(), innov, xEstVec, covEst);
+
+    updatedState->as<StateType>()->setXYYaw(xEstVec[0], xEstVec[1], xEstVec[2]);
+
+    updatedState->as<StateType>()->setCovariance(covEst);
+
+    return;
+  }
+
   mat rightMatrix = H * covPred * trans(H) + ls.getR();
   mat leftMatrix = covPred * trans(H);
   mat KalmanGain = solve(trans(rightMatrix), trans(leftMatrix));
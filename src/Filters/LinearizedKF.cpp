@@ -70,6 +70,21 @@ const LinearSystem& ls, ompl::base::State *updatedState)
 
     mat covPred = belief->as<StateType>()->getCovariance();
 
+    // with independent noise the elements are folded in one by one, linear in the number of observations
+    if(ls.hasIndependentObservationNoise())
+    {
+        colvec xEstVec;
+        mat covEst;
+
+        sequentialUpdate(belief->as<StateType>()->getArmaData(), covPred, ls.getH(), ls.getRVariance(), innov, xEstVec, covEst);
+
+        updatedState->as<StateType>()->setXYYaw(xEstVec[0], xEstVec[1], xEstVec[2]);
+
+        updatedState->as<StateType>()->setCovariance(covEst);
+
+        return;
+    }
+
     mat rightMatrix = ls.getH() * covPred * trans(ls.getH()) + ls.getR();
     mat leftMatrix = covPred * trans(ls.getH());
     mat KalmanGain = solve(trans(rightMatrix), trans(leftMatrix));
@@ -118,13 +133,12 @@ arma::mat LinearizedKF::computeStationaryCovariance (const LinearSystem& ls)
 {
     using namespace arma;
 
-    mat H = ls.getH();
-    mat M = ls.getM();
-    mat R = ls.getR();
+    mat A, B, Q, R;
+
+    stationaryRiccatiProblem(ls, A, B, Q, R);
 
     mat Pprd;
-    bool dareSolvable = dare (trans(ls.getA()),trans(ls.getH()),ls.getG() * ls.getQ() * trans(ls.getG()),
-    ls.getM() * ls.getR() * trans(ls.getM()), Pprd );
+    bool dareSolvable = dare (A, B, Q, R, Pprd);
 
     if(!dareSolvable)
     {
@@ -132,8 +146,30 @@ arma::mat LinearizedKF::computeStationaryCovariance (const LinearSystem& ls)
         exit(1);
     }
 
+    return computeStationaryCovariance(ls, Pprd);
+}
+
+void LinearizedKF::stationaryRiccatiProblem(const LinearSystem& ls, arma::mat &A, arma::mat &B, arma::mat &Q, arma::mat &R)
+{
+    using namespace arma;
+
+    // the filter Riccati equation is the dual of the control one
+    A = trans(ls.getA());
+    B = trans(ls.getH());
+    Q = ls.getG() * ls.getQ() * trans(ls.getG());
+    R = ls.getM() * ls.getR() * trans(ls.getM());
+}
+
+arma::mat LinearizedKF::computeStationaryCovariance (const LinearSystem& ls, const arma::mat &stationaryPrediction)
+{
+    using namespace arma;
+
+    mat H = ls.getH();
+    mat M = ls.getM();
+    mat R = ls.getR();
+
     //makes this symmetric
-    Pprd = (Pprd + trans(Pprd)) / 2;
+    mat Pprd = (stationaryPrediction + trans(stationaryPrediction)) / 2;
 
     mat Pest = Pprd - ( Pprd * H.t()) * inv( H*Pprd*H.t() + M * R * M.t()) * trans(Pprd * H.t()) ;
 
@@ -160,7 +160,7 @@ void OmnidirectionalMotionModel::generateOpenLoopControls(const ompl::base::Stat
 
         for(int i=0; i<translation_steps; i++)
         {
-          ompl::control::Control *tempControl = si_->allocControl();
+          ompl::control::Control *tempControl = allocControl();
           ARMA2OMPL(u_const_rot, tempControl);
           openLoopControls.push_back(tempControl);
         }
@@ -184,7 +184,7 @@ void OmnidirectionalMotionModel::generateOpenLoopControls(const ompl::base::Stat
 
             for(int i=0; i<rotation_steps; i++)
             {
-              ompl::control::Control *tempControl = si_->allocControl();
+              ompl::control::Control *tempControl = allocControl();
               ARMA2OMPL(u_const_rot, tempControl);
               openLoopControls.push_back(tempControl);
             }
@@ -90,7 +90,7 @@ void TwoDPointMotionModel::generateOpenLoopControls(const ompl::base::State *sta
 
     for(int i=0; i<translation_steps; i++)
     {
-      ompl::control::Control *tempControl = si_->allocControl();
+      ompl::control::Control *tempControl = allocControl();
       ARMA2OMPL(u_const, tempControl);
       openLoopControls.push_back(tempControl);
     }
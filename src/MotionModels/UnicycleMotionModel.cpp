@@ -136,14 +136,14 @@ void UnicycleMotionModel::generateOpenLoopControls(const ompl::base::State *star
     int ix = 0;
     for(int j=0; j<frsi; ++j, ++ix)
     {
-      ompl::control::Control *tempControl = si_->allocControl();
+      ompl::control::Control *tempControl = allocControl();
       ARMA2OMPL(u_const_rot, tempControl);
       openLoopControls.push_back(tempControl);
     }
 
     if(frsi < rsi)
     {
-      ompl::control::Control *tempControl = si_->allocControl();
+      ompl::control::Control *tempControl = allocControl();
       ARMA2OMPL(u_const_rot*(rsi-frsi), tempControl);
       openLoopControls.push_back(tempControl);
     }
@@ -162,13 +162,13 @@ void UnicycleMotionModel::generateOpenLoopControls(const ompl::base::State *star
 
     for(int j=0; j<ftsi; ++j, ++ix)
     {
-      ompl::control::Control *tempControl = si_->allocControl();
+      ompl::control::Control *tempControl = allocControl();
       ARMA2OMPL(u_const_trans, tempControl);
       openLoopControls.push_back(tempControl);
     }
     if(ftsi < tsi)
     {
-      ompl::control::Control *tempControl = si_->allocControl();
+      ompl::control::Control *tempControl = allocControl();
       ARMA2OMPL(u_const_trans*(tsi-ftsi), tempControl);
       openLoopControls.push_back(tempControl);
     }
@@ -184,14 +184,14 @@ void UnicycleMotionModel::generateOpenLoopControls(const ompl::base::State *star
 
     for(int j=0; j<frsi_end; ++j, ++ix)
     {
-      ompl::control::Control *tempControl = si_->allocControl();
+      ompl::control::Control *tempControl = allocControl();
       ARMA2OMPL(u_const_rot_end, tempControl);
       openLoopControls.push_back(tempControl);
     }
 
     if(frsi_end < rsi_end)
     {
-      ompl::control::Control *tempControl = si_->allocControl();
+      ompl::control::Control *tempControl = allocControl();
       ARMA2OMPL(u_const_rot_end*(rsi_end-frsi_end), tempControl);
       openLoopControls.push_back(tempControl);
     }
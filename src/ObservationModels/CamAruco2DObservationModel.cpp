@@ -38,12 +38,26 @@
 #include <tinyxml.h>
 #include "Visualization/Visualizer.h"
 #include "Utils/FIRMUtils.h"
+#include <algorithm>
+
+namespace
+{
+    /** \brief States of a visibility raster cell */
+    enum
+    {
+        VISIBILITY_UNKNOWN = 0,
+        VISIBILITY_CLEAR = 1,
+        VISIBILITY_BLOCKED = 2
+    };
+}
 
 namespace ompl
 {
     namespace magic
     {
         static const double ONE_STEP_DISTANCE_FOR_VISIBILITY = 0.5 ; // meters
+
+        static const double VISIBILITY_RASTER_RESOLUTION = 0.1 ; // meters, size of a cell in the line of sight rasters
     }
 }
 
@@ -53,62 +67,206 @@ namespace ompl
   such observations Obs dim is 2x the size of the landmarks
 */
 CamAruco2DObservationModel::ObservationType CamAruco2DObservationModel::getObservation(const ompl::base::State *state, bool isSimulation)
+{
+    ObservationType z;
+
+    this->getObservation(state, isSimulation, z);
+
+    return z;
+}
+
+void CamAruco2DObservationModel::getObservation(const ompl::base::State *state, bool isSimulation, ObservationType &z)
+{
+    // a batch of one, so single and batch observations come out of the same kernel
+    static thread_local std::vector<const ompl::base::State*> single(1);
+
+    static thread_local std::vector<ObservationType> observation(1);
+
+    single[0] = state;
+
+    CamAruco2DObservationModel::getObservations(single, isSimulation, observation);
+
+    // hand the result over and keep z's old buffer for the next call
+    z.swap(observation[0]);
+}
+
+void CamAruco2DObservationModel::getObservations(const std::vector<const ompl::base::State*> &states, bool isSimulation, std::vector<ObservationType> &observations)
 {
     using namespace arma;
 
-    //colvec xVec = state->as<SE2BeliefSpace::StateType>()->getArmaData();
+    const double pi = boost::math::constants::pi<double>();
 
-    ObservationType z;
+    const double fov = cameraHalfFov_*pi/180; // radians
 
-    int counter = 0;
+    const unsigned int numStates = states.size();
 
-    //generate observation from state, and corrupt with the given noise
-    for(unsigned int i = 0; i < landmarks_.size(); i++)
+    observations.resize(numStates);
+
+    // without a camera range nothing is ever visible
+    if(cameraRange_ <= 0)
+    {
+        for(unsigned int i = 0; i < numStates; i++)
+        {
+            observations[i].set_size(0);
+        }
+
+        return;
+    }
+
+    // the poses as flat arrays, and the states ordered by landmark grid cell so each cell is handled once
+    static thread_local std::vector<double> stateX, stateY, stateYaw;
+
+    static thread_local std::vector<std::pair<long long, unsigned int> > cellOrder;
+
+    stateX.resize(numStates);
+    stateY.resize(numStates);
+    stateYaw.resize(numStates);
+    cellOrder.resize(numStates);
+
+    for(unsigned int i = 0; i < numStates; i++)
+    {
+        const SE2BeliefSpace::StateType *x = states[i]->as<SE2BeliefSpace::StateType>();
+
+        stateX[i] = x->getX();
+        stateY[i] = x->getY();
+        stateYaw[i] = x->getYaw();
+
+        cellOrder[i] = std::make_pair(landmarkCellKey(std::floor(stateX[i] / cameraRange_), std::floor(stateY[i] / cameraRange_)), i);
+    }
+
+    std::sort(cellOrder.begin(), cellOrder.end());
+
+    // a landmark seen from one state of the group
+    struct Sighting
+    {
+        unsigned int member, landmark;
+        double range, bearing, viewingAngle;
+    };
+
+    static thread_local std::vector<double> groupX, groupY, groupYaw, groupCos, groupSin, ranges, bearings;
+
+    static thread_local std::vector<unsigned int> inRange, counts;
+
+    static thread_local std::vector<Sighting> sightings;
+
+    for(unsigned int begin = 0, end = 0; begin < numStates; begin = end)
     {
+        while(end < numStates && cellOrder[end].first == cellOrder[begin].first)
+            end++;
+
+        const unsigned int groupSize = end - begin;
 
-        double landmarkRange =0, landmarkBearing = 0, relativeAngle = 0;
+        groupX.resize(groupSize);
+        groupY.resize(groupSize);
+        groupYaw.resize(groupSize);
+        groupCos.resize(groupSize);
+        groupSin.resize(groupSize);
+        ranges.resize(groupSize);
+        bearings.resize(groupSize);
 
-        if(isLandmarkVisible(state, landmarks_[i], landmarkRange , landmarkBearing, relativeAngle))
+        for(unsigned int k = 0; k < groupSize; k++)
         {
+            const unsigned int i = cellOrder[begin+k].second;
 
-            //cout<<"Trying to resize"<<endl;
-            z.resize((counter+1)*singleObservationDim ,  1);
+            groupX[k] = stateX[i];
+            groupY[k] = stateY[i];
+            groupYaw[k] = stateYaw[i];
+            groupCos[k] = std::cos(stateYaw[i]);
+            groupSin[k] = std::sin(stateYaw[i]);
+        }
 
-            colvec noise = zeros<colvec>(landmarkInfoDim);
+        // every state of the group shares the same candidate landmarks
+        this->getLandmarksInRange(states[cellOrder[begin].second], inRange);
 
-            if(isSimulation)
+        sightings.clear();
+
+        for(unsigned int n = 0; n < inRange.size(); n++)
+        {
+            const unsigned int l = inRange[n];
+
+            const double lx = landmarkX_[l];
+            const double ly = landmarkY_[l];
+
+            // no dependence between iterations, so this vectorizes across the group
+            for(unsigned int k = 0; k < groupSize; k++)
             {
+                const double dx = lx - groupX[k];
+                const double dy = ly - groupY[k];
 
-                // generate gaussian noise
-                //get standard deviations of noise (sqrt of covariance matrix)
-                //extract state from Cfg and normalize
-                //generate noise scaling/shifting factor
+                ranges[k] = std::sqrt(dx*dx + dy*dy);
+                bearings[k] = std::atan2(dy, dx) - groupYaw[k];
+            }
+
+            for(unsigned int k = 0; k < groupSize; k++)
+            {
+                double bearing = bearings[k];
+
+                FIRMUtils::normalizeAngleToPiRange(bearing);
+
+                // too close or on top of the landmark is not seen, this also keeps the noise covariance away from 0
+                if(ranges[k] < 1e-2 || ranges[k] > cameraRange_ || std::abs(bearing) > fov)
+                    continue;
+
+                if(!hasClearLineOfSight(groupX[k], groupY[k], l))
+                    continue;
+
+                double viewingAngle = std::abs(std::acos(landmarkCosTheta_[l]*groupCos[k] + landmarkSinTheta_[l]*groupSin[k]));
+
+                if( viewingAngle > pi/2 )
+                    viewingAngle = std::abs(viewingAngle - pi);
+
+                Sighting sighting = {k, l, ranges[k], bearing, viewingAngle};
+
+                sightings.push_back(sighting);
+            }
+        }
+
+        // size every observation once, the counts are then reused as write positions
+        counts.assign(groupSize, 0);
+
+        for(unsigned int s = 0; s < sightings.size(); s++)
+        {
+            counts[sightings[s].member]++;
+        }
+
+        for(unsigned int k = 0; k < groupSize; k++)
+        {
+            observations[cellOrder[begin+k].second].set_size(counts[k]*singleObservationDim);
+
+            counts[k] = 0;
+        }
+
+        // sightings are in landmark list order for every state, the same order a full scan gives
+        for(unsigned int s = 0; s < sightings.size(); s++)
+        {
+            const Sighting &v = sightings[s];
+
+            ObservationType &z = observations[cellOrder[begin+v.member].second];
+
+            const unsigned int counter = counts[v.member]++;
+
+            double rangeNoise = 0, bearingNoise = 0;
 
-                colvec noise_std = this->etaD_*landmarkRange + this->etaPhi_*relativeAngle + this->sigma_;
+            if(isSimulation)
+            {
+                //generate noise scaling/shifting factor
+                colvec noise_std = this->etaD_*v.range + this->etaPhi_*v.viewingAngle + this->sigma_;
 
                 //generate raw noise
                 colvec randNoiseVec = randn<colvec>(2);
 
                 //generate noise from a distribution scaled and shifted from
                 //normal distribution N(0,1) to N(0,eta*range + sigma)
-                //(shifting was done in GetNoiseCovariance)
-                noise = noise_std%randNoiseVec;
+                rangeNoise = noise_std[0]*randNoiseVec[0];
+                bearingNoise = noise_std[1]*randNoiseVec[1];
             }
 
-            z[singleObservationDim*counter] = landmarks_[i](0) ; // id of the landmark
-            assert(landmarkRange <= cameraRange_);
-            z[singleObservationDim*counter + 1 ] = landmarkRange + noise[0]; // distance to landmark
-            z[singleObservationDim*counter+2] = landmarkBearing + noise[1];
-            z[singleObservationDim*counter+3] = landmarks_[i](3);
-
-            assert(abs( z[singleObservationDim*counter+2]) <= boost::math::constants::pi<double>());
-
-            counter++;
+            z[singleObservationDim*counter] = landmarks_[v.landmark](0) ; // id of the landmark
+            z[singleObservationDim*counter + 1 ] = v.range + rangeNoise; // distance to landmark
+            z[singleObservationDim*counter+2] = v.bearing + bearingNoise;
+            z[singleObservationDim*counter+3] = landmarks_[v.landmark](3);
         }
     }
-
-  return z;
-
 }
 
 bool isUnique(const arma::colvec z)
@@ -138,7 +296,7 @@ CamAruco2DObservationModel::getObservationPrediction(const ompl::base::State *st
 
     colvec xVec =  state->as<SE2BeliefSpace::StateType>()->getArmaData();
 
-    ObservationType z;
+    ObservationType z(Zg.n_rows / singleObservationDim * singleObservationDim);
 
     for(unsigned int k = 0; k< Zg.n_rows / singleObservationDim ;k++)
     {
@@ -146,8 +304,6 @@ CamAruco2DObservationModel::getObservationPrediction(const ompl::base::State *st
         colvec candidate;
 
         int candidateIndx = this->findCorrespondingLandmark(state, Zg.subvec(singleObservationDim*k,singleObservationDim*k+3), candidate);
-
-        z.resize((k+1)*singleObservationDim ,  1);
         z[singleObservationDim*k]     = candidate(0)  ; // id of the landmark
         z[singleObservationDim*k + 1] = candidate(1) ;  // distance to landmark
         z[singleObservationDim*k+2]   = candidate(2)  ; // bearing
@@ -211,6 +367,56 @@ double CamAruco2DObservationModel::getDataAssociationLikelihood(const arma::colv
 }
 
 
+int CamAruco2DObservationModel::findCorrespondingLandmark(const double x, const double y, const double yaw, const int landmarkID, const double range,
+                                                          const double bearing, double &predictedRange, double &predictedBearing) const
+{
+    const double rangeVariance = sigma_(0)*sigma_(0);
+    const double bearingVariance = sigma_(1)*sigma_(1);
+
+    double maxLikelihood = -1.0;
+
+    int candidateIndx = -1;
+
+    std::unordered_map<int, std::vector<unsigned int> >::const_iterator sameID = landmarkIdIndex_.find(landmarkID);
+
+    if(sameID != landmarkIdIndex_.end())
+    {
+        for(unsigned int n = 0; n < sameID->second.size(); n++)
+        {
+            const unsigned int l = sameID->second[n];
+
+            const double dx = landmarkX_[l] - x;
+            const double dy = landmarkY_[l] - y;
+
+            const double landmarkRange = std::sqrt(dx*dx + dy*dy);
+
+            double landmarkBearing = std::atan2(dy, dx) - yaw;
+
+            FIRMUtils::normalizeAngleToPiRange(landmarkBearing);
+
+            const double rangeError = range - landmarkRange;
+
+            double bearingError = bearing - landmarkBearing;
+
+            FIRMUtils::normalizeAngleToPiRange(bearingError);
+
+            const double lkhd = std::exp(-0.5*(rangeError*rangeError/rangeVariance + bearingError*bearingError/bearingVariance));
+
+            if(lkhd > maxLikelihood)
+            {
+                candidateIndx = l;
+                maxLikelihood = lkhd;
+                predictedRange = landmarkRange;
+                predictedBearing = landmarkBearing;
+            }
+        }
+    }
+
+    assert(candidateIndx >= 0 && "Candidate index cannot be negative");
+
+    return candidateIndx;
+}
+
 int CamAruco2DObservationModel::findCorrespondingLandmark(const ompl::base::State *state, const arma::colvec &observedLandmark, arma::colvec &candidateObservation)
 {
     using namespace arma;
@@ -223,10 +429,14 @@ int CamAruco2DObservationModel::findCorrespondingLandmark(const ompl::base::Stat
 
     int candidateIndx = -1;
 
-    for(unsigned int i = 0; i < landmarks_.size() ; i++)
+    std::unordered_map<int, std::vector<unsigned int> >::const_iterator sameID = landmarkIdIndex_.find(landmarkID);
+
+    if(sameID != landmarkIdIndex_.end())
     {
-        if(landmarks_[i](0) == landmarkID)
+        for(unsigned int n = 0; n < sameID->second.size(); n++)
         {
+            const unsigned int i = sameID->second[n];
+
             double landmarkRange =0, landmarkBearing = 0;
 
             // get range and bearing to landmark
@@ -262,47 +472,199 @@ int CamAruco2DObservationModel::findCorrespondingLandmark(const ompl::base::Stat
 }
 
 
-bool CamAruco2DObservationModel::hasClearLineOfSight(const ompl::base::State *state, const arma::colvec& landmark )
+bool CamAruco2DObservationModel::hasClearLineOfSight(const ompl::base::State *state, const unsigned int landmarkIndex)
 {
+    const SE2BeliefSpace::StateType *x = state->as<SE2BeliefSpace::StateType>();
 
-    using namespace arma;
+    return hasClearLineOfSight(x->getX(), x->getY(), landmarkIndex);
+}
 
-    colvec xVec = state->as<SE2BeliefSpace::StateType>()->getArmaData();
+bool CamAruco2DObservationModel::hasClearLineOfSight(const double x, const double y, const unsigned int landmarkIndex)
+{
+    const arma::colvec &landmark = landmarks_[landmarkIndex];
 
-    colvec robot_to_landmark_ray =  landmark.subvec(1,2) - xVec.subvec(0,1);
+    VisibilityRaster &raster = visibility_[landmarkIndex];
 
-    double distance = norm(robot_to_landmark_ray,2);
+    const double resolution = ompl::magic::VISIBILITY_RASTER_RESOLUTION;
+
+    const int cellX = std::floor((x - raster.originX) / resolution);
+    const int cellY = std::floor((y - raster.originY) / resolution);
+
+    if(cellX < 0 || cellY < 0 || cellX >= raster.size || cellY >= raster.size)
+        return marchLineOfSight(x, y, landmark);
+
+    std::atomic<unsigned char> &cell = raster.cells[cellY*raster.size + cellX];
+
+    unsigned char visibility = cell.load(std::memory_order_relaxed);
+
+    if(visibility == VISIBILITY_UNKNOWN)
+    {
+        // the ray is cast from the cell center, so every state in the cell gets the same answer
+        const bool isClear = marchLineOfSight(raster.originX + (cellX + 0.5)*resolution, raster.originY + (cellY + 0.5)*resolution, landmark);
+
+        visibility = isClear ? VISIBILITY_CLEAR : VISIBILITY_BLOCKED;
+
+        cell.store(visibility, std::memory_order_relaxed);
+    }
+
+    return visibility == VISIBILITY_CLEAR;
+}
+
+bool CamAruco2DObservationModel::marchLineOfSight(const double x, const double y, const arma::colvec& landmark)
+{
+    const double rayX = landmark(1) - x;
+
+    const double rayY = landmark(2) - y;
+
+    double distance = std::sqrt(rayX*rayX + rayY*rayY);
 
     int steps = std::floor(distance/ompl::magic::ONE_STEP_DISTANCE_FOR_VISIBILITY);
 
     ompl::base::State *tempState = this->si_->allocState();
 
+    bool isClear = true;
+
     for(int i=1 ; i < steps; i++)
     {
-        double newX = xVec(0) + i*robot_to_landmark_ray(0)/steps;
+        double newX = x + i*rayX/steps;
 
-        double newY = xVec(1) + i*robot_to_landmark_ray(1)/steps;
+        double newY = y + i*rayY/steps;
 
         tempState->as<SE2BeliefSpace::StateType>()->setXYYaw(newX, newY,0);
 
         if(!this->si_->isValid(tempState))
         {
-            return false;
+            isClear = false;
+            break;
         }
 
     }
 
     si_->freeState(tempState);
 
-    return true;
+    return isClear;
 }
 
+void CamAruco2DObservationModel::buildVisibilityRasters()
+{
+    const double resolution = ompl::magic::VISIBILITY_RASTER_RESOLUTION;
+
+    const int halfCells = cameraRange_ > 0 ? std::ceil(cameraRange_ / resolution) : 0;
+
+    visibility_.clear();
+
+    visibility_.resize(landmarks_.size());
+
+    for(unsigned int i = 0; i < landmarks_.size(); i++)
+    {
+        // the landmark sits in the center cell
+        visibility_[i].originX = landmarks_[i](1) - (halfCells + 0.5)*resolution;
+        visibility_[i].originY = landmarks_[i](2) - (halfCells + 0.5)*resolution;
+        visibility_[i].size = 2*halfCells + 1;
+        visibility_[i].cells.reset(new std::atomic<unsigned char>[visibility_[i].size*visibility_[i].size]);
+    }
+
+    clearVisibilityCache();
+}
 
-bool CamAruco2DObservationModel::isLandmarkVisible(const ompl::base::State *state, const arma::colvec& landmark,
+void CamAruco2DObservationModel::clearVisibilityCache()
+{
+    for(unsigned int i = 0; i < visibility_.size(); i++)
+    {
+        const int numCells = visibility_[i].size*visibility_[i].size;
+
+        for(int c = 0; c < numCells; c++)
+        {
+            visibility_[i].cells[c].store(VISIBILITY_UNKNOWN, std::memory_order_relaxed);
+        }
+    }
+}
+
+void CamAruco2DObservationModel::clearVisibilityCache(const arma::mat &changedRegions)
+{
+    const double resolution = ompl::magic::VISIBILITY_RASTER_RESOLUTION;
+
+    unsigned int numCleared = 0;
+
+    for(unsigned int i = 0; i < visibility_.size(); i++)
+    {
+        VisibilityRaster &raster = visibility_[i];
+
+        const double rasterMaxX = raster.originX + raster.size*resolution;
+        const double rasterMaxY = raster.originY + raster.size*resolution;
+
+        const double landmarkX = landmarks_[i](1);
+        const double landmarkY = landmarks_[i](2);
+
+        for(unsigned int r = 0; r < changedRegions.n_cols; r++)
+        {
+            const double minX = changedRegions(0, r), minY = changedRegions(1, r);
+            const double maxX = changedRegions(2, r), maxY = changedRegions(3, r);
+
+            // every ray the raster caches lies inside its square
+            if(maxX < raster.originX || minX > rasterMaxX || maxY < raster.originY || minY > rasterMaxY)
+                continue;
+
+            for(int cellY = 0; cellY < raster.size; cellY++)
+            {
+                for(int cellX = 0; cellX < raster.size; cellX++)
+                {
+                    std::atomic<unsigned char> &cell = raster.cells[cellY*raster.size + cellX];
+
+                    if(cell.load(std::memory_order_relaxed) == VISIBILITY_UNKNOWN)
+                        continue;
+
+                    // clip the ray from the cell center to the landmark against the box (Liang-Barsky)
+                    const double x = raster.originX + (cellX + 0.5)*resolution;
+                    const double y = raster.originY + (cellY + 0.5)*resolution;
+
+                    const double p[4] = {x - landmarkX, landmarkX - x, y - landmarkY, landmarkY - y};
+                    const double q[4] = {x - minX, maxX - x, y - minY, maxY - y};
+
+                    double t0 = 0, t1 = 1;
+
+                    bool crosses = true;
+
+                    for(int k = 0; k < 4 && crosses; k++)
+                    {
+                        if(p[k] == 0)
+                        {
+                            crosses = q[k] >= 0;
+                        }
+                        else if(p[k] < 0)
+                        {
+                            t0 = std::max(t0, q[k]/p[k]);
+                        }
+                        else
+                        {
+                            t1 = std::min(t1, q[k]/p[k]);
+                        }
+
+                        crosses = crosses && t0 <= t1;
+                    }
+
+                    if(!crosses)
+                        continue;
+
+                    cell.store(VISIBILITY_UNKNOWN, std::memory_order_relaxed);
+
+                    numCleared++;
+                }
+            }
+        }
+    }
+
+    OMPL_INFORM("CamAruco2DObservationModel: Cleared %u cached lines of sight through %u changed regions", numCleared, (unsigned int)changedRegions.n_cols);
+}
+
+
+bool CamAruco2DObservationModel::isLandmarkVisible(const ompl::base::State *state, const unsigned int landmarkIndex,
                                                               double& range, double& bearing, double& viewingAngle)
 {
     using namespace arma;
 
+    const colvec &landmark = landmarks_[landmarkIndex];
+
     colvec xVec = state->as<SE2BeliefSpace::StateType>()->getArmaData();
 
     double fov = cameraHalfFov_*boost::math::constants::pi<double>()/180; // radians
@@ -328,7 +690,7 @@ bool CamAruco2DObservationModel::isLandmarkVisible(const ompl::base::State *stat
 
     if( abs(bearing) <= fov && range <= maxRange )
     {
-        if(hasClearLineOfSight(state, landmark))
+        if(hasClearLineOfSight(state, landmarkIndex))
         {
             assert(abs(viewingAngle) <= boost::math::constants::pi<double>() / 2 );
             return true;
@@ -376,6 +738,50 @@ CamAruco2DObservationModel::getObservationJacobian(const ompl::base::State *stat
 }
 
 
+void CamAruco2DObservationModel::getObservationJacobians(const std::vector<const ompl::base::State*> &states, const std::vector<ObservationType> &observations,
+                                                         std::vector<JacobianType> &jacobians)
+{
+    assert(states.size() == observations.size());
+
+    jacobians.resize(states.size());
+
+    for(unsigned int i = 0; i < states.size(); i++)
+    {
+        const SE2BeliefSpace::StateType *x = states[i]->as<SE2BeliefSpace::StateType>();
+
+        const ObservationType &z = observations[i];
+
+        const unsigned int number_of_landmarks = z.n_rows / singleObservationDim;
+
+        JacobianType &H = jacobians[i];
+
+        H.set_size(landmarkInfoDim*number_of_landmarks, stateDim);
+
+        for(unsigned int k = 0; k < number_of_landmarks; k++)
+        {
+            double predictedRange = 0, predictedBearing = 0;
+
+            const int Indx = this->findCorrespondingLandmark(x->getX(), x->getY(), x->getYaw(), z(k*singleObservationDim), z(k*singleObservationDim + 1),
+                                                             z(k*singleObservationDim + 2), predictedRange, predictedBearing);
+
+            const double dx = landmarkX_[Indx] - x->getX();
+            const double dy = landmarkY_[Indx] - x->getY();
+
+            const double phi = std::atan2(dy, dx);
+
+            const double r = std::sqrt(dx*dx + dy*dy);
+
+            H(landmarkInfoDim*k, 0) = -std::cos(phi);
+            H(landmarkInfoDim*k, 1) = -std::sin(phi);
+            H(landmarkInfoDim*k, 2) = 0;
+
+            H(landmarkInfoDim*k + 1, 0) = std::sin(phi)/r;
+            H(landmarkInfoDim*k + 1, 1) = -std::cos(phi)/r;
+            H(landmarkInfoDim*k + 1, 2) = -1;
+        }
+    }
+}
+
 typename CamAruco2DObservationModel::JacobianType
 CamAruco2DObservationModel::getNoiseJacobian(const ompl::base::State *state, const ObsNoiseType& _v, const ObservationType& z)
 {
@@ -393,6 +799,12 @@ CamAruco2DObservationModel::getNoiseJacobian(const ompl::base::State *state, con
 
 
 arma::mat CamAruco2DObservationModel::getObservationNoiseCovariance(const ompl::base::State *state, const ObservationType& z)
+{
+    //return covariance matrix generated from vector of covariances
+    return arma::diagmat(this->getObservationNoiseVariance(state, z));
+}
+
+arma::colvec CamAruco2DObservationModel::getObservationNoiseVariance(const ompl::base::State *state, const ObservationType& z)
 {
     using namespace arma;
 
@@ -423,10 +835,7 @@ arma::mat CamAruco2DObservationModel::getObservationNoiseCovariance(const ompl::
     }
 
     //square the factors to get the covariances
-    noise = pow(noise,2);
-
-    //return covariance matrix generated from vector of covariances
-    return diagmat(noise);
+    return pow(noise,2);
 
 }
 
@@ -476,38 +885,138 @@ CamAruco2DObservationModel::computeInnovation(const ompl::base::State *predicted
 }
 
 
-typename CamAruco2DObservationModel::ObservationType CamAruco2DObservationModel::removeSpuriousObservations(const ObservationType& Zg)
+void CamAruco2DObservationModel::computeInnovations(const std::vector<const ompl::base::State*> &predictedStates, const ObservationType& Zg,
+                                                    std::vector<ObservationType> &innovations)
 {
+    const unsigned int numStates = predictedStates.size();
 
+    const unsigned int numObserved = Zg.n_rows / singleObservationDim;
 
-    ObservationType Zcorrected;
+    innovations.resize(numStates);
 
-    int counter  = 0;
-    for(unsigned int i=0; i < Zg.n_rows / singleObservationDim ; i++)
+    for(unsigned int i = 0; i < numStates; i++)
     {
+        innovations[i].set_size(landmarkInfoDim*numObserved);
+    }
+
+    if(numObserved == 0)
+        return;
+
+    const double rangeVariance = sigma_(0)*sigma_(0);
+    const double bearingVariance = sigma_(1)*sigma_(1);
+
+    static thread_local std::vector<double> stateX, stateY, stateYaw, ranges, bearings, maxLikelihood, bestRange, bestBearing;
 
-        for(unsigned int j=0; j < landmarks_.size() ; j++)
+    stateX.resize(numStates);
+    stateY.resize(numStates);
+    stateYaw.resize(numStates);
+    ranges.resize(numStates);
+    bearings.resize(numStates);
+
+    for(unsigned int i = 0; i < numStates; i++)
+    {
+        const SE2BeliefSpace::StateType *x = predictedStates[i]->as<SE2BeliefSpace::StateType>();
+
+        stateX[i] = x->getX();
+        stateY[i] = x->getY();
+        stateYaw[i] = x->getYaw();
+    }
+
+    for(unsigned int k = 0; k < numObserved; k++)
+    {
+        const int landmarkID = Zg(singleObservationDim*k);
+        const double observedRange = Zg(singleObservationDim*k + 1);
+        const double observedBearing = Zg(singleObservationDim*k + 2);
+
+        std::unordered_map<int, std::vector<unsigned int> >::const_iterator sameID = landmarkIdIndex_.find(landmarkID);
+
+        assert(sameID != landmarkIdIndex_.end() && "Candidate index cannot be negative");
+
+        maxLikelihood.assign(numStates, -1.0);
+        bestRange.assign(numStates, 0.0);
+        bestBearing.assign(numStates, 0.0);
+
+        // the same association as findCorrespondingLandmark, one candidate landmark at a time for all states
+        for(unsigned int n = 0; n < sameID->second.size(); n++)
         {
+            const unsigned int l = sameID->second[n];
+
+            const double lx = landmarkX_[l];
+            const double ly = landmarkY_[l];
 
-            if(Zg(i*singleObservationDim) == landmarks_[j](0))
+            // no dependence between iterations, so this vectorizes across the states
+            for(unsigned int i = 0; i < numStates; i++)
             {
+                const double dx = lx - stateX[i];
+                const double dy = ly - stateY[i];
 
-                Zcorrected.resize(singleObservationDim*(counter +1));
+                ranges[i] = std::sqrt(dx*dx + dy*dy);
+                bearings[i] = std::atan2(dy, dx) - stateYaw[i];
+            }
+
+            for(unsigned int i = 0; i < numStates; i++)
+            {
+                double bearing = bearings[i];
 
-                Zcorrected(singleObservationDim*counter) =    Zg(i*singleObservationDim);
+                FIRMUtils::normalizeAngleToPiRange(bearing);
 
-                Zcorrected(singleObservationDim*counter+1) =  Zg(i*singleObservationDim+1);
+                const double rangeError = observedRange - ranges[i];
 
-                Zcorrected(singleObservationDim*counter+2) =  Zg(i*singleObservationDim+2);
+                double bearingError = observedBearing - bearing;
 
-                counter++;
-                break;
+                FIRMUtils::normalizeAngleToPiRange(bearingError);
+
+                const double lkhd = std::exp(-0.5*(rangeError*rangeError/rangeVariance + bearingError*bearingError/bearingVariance));
+
+                if(lkhd > maxLikelihood[i])
+                {
+                    maxLikelihood[i] = lkhd;
+                    bestRange[i] = ranges[i];
+                    bestBearing[i] = bearing;
+                }
             }
+        }
+
+        for(unsigned int i = 0; i < numStates; i++)
+        {
+            innovations[i](landmarkInfoDim*k) = observedRange - bestRange[i];
 
+            double delta_theta = observedBearing - bestBearing[i];
+
+            FIRMUtils::normalizeAngleToPiRange(delta_theta);
+
+            innovations[i](landmarkInfoDim*k + 1) = delta_theta;
+        }
+    }
+}
+
+typename CamAruco2DObservationModel::ObservationType CamAruco2DObservationModel::removeSpuriousObservations(const ObservationType& Zg)
+{
+
+
+    // sized for the worst case and trimmed once at the end
+    ObservationType Zcorrected = arma::zeros<ObservationType>(Zg.n_rows / singleObservationDim * singleObservationDim);
+
+    int counter  = 0;
+    for(unsigned int i=0; i < Zg.n_rows / singleObservationDim ; i++)
+    {
+
+        if(landmarkIdIndex_.count(Zg(i*singleObservationDim)))
+        {
+
+            Zcorrected(singleObservationDim*counter) =    Zg(i*singleObservationDim);
+
+            Zcorrected(singleObservationDim*counter+1) =  Zg(i*singleObservationDim+1);
+
+            Zcorrected(singleObservationDim*counter+2) =  Zg(i*singleObservationDim+2);
+
+            counter++;
         }
 
     }
 
+    Zcorrected.resize(singleObservationDim*counter);
+
     return Zcorrected;
 
 }
@@ -567,6 +1076,70 @@ void CamAruco2DObservationModel::loadLandmarks(const char *pathToSetupFile)
     Visualizer::addLandmarks(landmarks_);
 }
 
+void CamAruco2DObservationModel::buildLandmarkIndex()
+{
+    landmarkGrid_.clear();
+    landmarkIdIndex_.clear();
+
+    landmarkX_.resize(landmarks_.size());
+    landmarkY_.resize(landmarks_.size());
+    landmarkCosTheta_.resize(landmarks_.size());
+    landmarkSinTheta_.resize(landmarks_.size());
+
+    for(unsigned int i = 0; i < landmarks_.size(); i++)
+    {
+        landmarkIdIndex_[landmarks_[i](0)].push_back(i);
+
+        // the landmark orientation is stored in multiples of pi
+        landmarkX_[i] = landmarks_[i](1);
+        landmarkY_[i] = landmarks_[i](2);
+        landmarkCosTheta_[i] = std::cos(landmarks_[i](3)*boost::math::constants::pi<double>());
+        landmarkSinTheta_[i] = std::sin(landmarks_[i](3)*boost::math::constants::pi<double>());
+
+        // without a camera range nothing is ever visible, so the grid stays empty
+        if(cameraRange_ <= 0)
+            continue;
+
+        const int cellX = std::floor(landmarks_[i](1) / cameraRange_);
+        const int cellY = std::floor(landmarks_[i](2) / cameraRange_);
+
+        landmarkGrid_[landmarkCellKey(cellX, cellY)].push_back(i);
+    }
+}
+
+void CamAruco2DObservationModel::getLandmarksInRange(const ompl::base::State *state, std::vector<unsigned int> &indices) const
+{
+    indices.clear();
+
+    if(cameraRange_ <= 0)
+        return;
+
+    const SE2BeliefSpace::StateType *x = state->as<SE2BeliefSpace::StateType>();
+
+    // the cells are as large as the camera range, so every landmark in range is in one of the 9 cells around the state
+    const int cellX = std::floor(x->getX() / cameraRange_);
+    const int cellY = std::floor(x->getY() / cameraRange_);
+
+    for(int dx = -1; dx <= 1; dx++)
+    {
+        for(int dy = -1; dy <= 1; dy++)
+        {
+            std::unordered_map<long long, std::vector<unsigned int> >::const_iterator cell = landmarkGrid_.find(landmarkCellKey(cellX+dx, cellY+dy));
+
+            if(cell != landmarkGrid_.end())
+                indices.insert(indices.end(), cell->second.begin(), cell->second.end());
+        }
+    }
+
+    // keep the order of the landmark list so observations come out the same as a full scan
+    std::sort(indices.begin(), indices.end());
+}
+
+long long CamAruco2DObservationModel::landmarkCellKey(const int cellX, const int cellY)
+{
+    return ((long long)cellX << 32) ^ (long long)(unsigned int)cellY;
+}
+
 void CamAruco2DObservationModel::loadParameters(const char *pathToSetupFile)
 {
     using namespace arma;
@@ -650,3 +1223,17 @@ bool CamAruco2DObservationModel::isStateObservable(const ompl::base::State *stat
   return false;
 
 }
+
+void CamAruco2DObservationModel::areStatesObservable(const std::vector<const ompl::base::State*> &states, std::vector<bool> &observable)
+{
+    static thread_local std::vector<ObservationType> observations;
+
+    this->getObservations(states, false, observations);
+
+    observable.resize(states.size());
+
+    for(unsigned int i = 0; i < states.size(); i++)
+    {
+        observable[i] = observations[i].n_rows >= numLandmarksForObservability*singleObservationDim;
+    }
+}
@@ -42,10 +42,20 @@
 
 typename HeadingBeaconObservationModel::ObservationType 
 HeadingBeaconObservationModel::getObservation(const ompl::base::State *state, bool isSimulation)
+{
+    ObservationType z;
+
+    this->getObservation(state, isSimulation, z);
+
+    return z;
+}
+
+void HeadingBeaconObservationModel::getObservation(const ompl::base::State *state, bool isSimulation, ObservationType &z)
 {
 	using namespace arma;
 
-    ObservationType z(1);
+    // every beacon is always observed, so the size is known up front
+    z.set_size(1 + landmarks_.size()*singleObservationDim);
 
     z[0] = state->as<SE2BeliefSpace::StateType>()->getYaw();
 
@@ -66,8 +76,6 @@ HeadingBeaconObservationModel::getObservation(const ompl::base::State *state, bo
         double range =0;
 
         calculateRangeToLandmark(state, landmarks_[i], range);
-        
-        z.resize(1+(i+1)*singleObservationDim ,  1);
 
         colvec noise = zeros<colvec>(obsNoiseDim);
 
@@ -89,8 +97,6 @@ HeadingBeaconObservationModel::getObservation(const ompl::base::State *state, bo
 
         z[1+singleObservationDim*i] = 1.0/(pow(range,2)+1) + noise[0];        
     }
-
- 	return z;
 }
 
 typename HeadingBeaconObservationModel::ObservationType 
@@ -98,7 +104,7 @@ HeadingBeaconObservationModel::getObservationPrediction(const ompl::base::State
 {
 	using namespace arma;
 
-    ObservationType z(1);
+    ObservationType z(1 + landmarks_.size()*singleObservationDim);
 
     z[0] = state->as<SE2BeliefSpace::StateType>()->getYaw();
 
@@ -109,8 +115,6 @@ HeadingBeaconObservationModel::getObservationPrediction(const ompl::base::State
         double range =0;
 
         calculateRangeToLandmark(state, landmarks_[i], range);
-        
-        z.resize(1+(i+1)*singleObservationDim ,  1);
 
         z[1+singleObservationDim*i] = 1/(pow(range,2)+1);        
     }
@@ -183,19 +187,22 @@ typename HeadingBeaconObservationModel::ObservationType HeadingBeaconObservation
 }
 
 arma::mat HeadingBeaconObservationModel::getObservationNoiseCovariance(const ompl::base::State *state, const ObservationType& z)
+{
+    return arma::diagmat(this->getObservationNoiseVariance(state, z));
+}
+
+arma::colvec HeadingBeaconObservationModel::getObservationNoiseVariance(const ompl::base::State *state, const ObservationType& z)
 {
 	using namespace arma;
 
     unsigned int number_of_landmarks = landmarks_.size();
 
-    mat R(1+number_of_landmarks,1+number_of_landmarks);
+    colvec R(1+number_of_landmarks);
 
-    R.eye();
-
-    R = R*pow(this->sigma_(0),2);
+    R.fill(pow(this->sigma_(0),2));
 
     // heading obs error covariance needs to be set separately
-    R(0,0) = pow(sigmaHeading_[0],2);
+    R(0) = pow(sigmaHeading_[0],2);
 
     return R;
 }
@@ -215,11 +222,8 @@ void HeadingBeaconObservationModel::calculateRangeToLandmark(const ompl::base::S
 bool HeadingBeaconObservationModel::isStateObservable(const ompl::base::State *state)
 {
 
-  using namespace arma;
-
-  colvec obs = this->getObservation(state, false);
-
-  if(obs.n_rows > 2)
+  // every beacon is always observed, so the observation length does not depend on the state
+  if(1 + landmarks_.size()*singleObservationDim > 2)
       return true;
 
   return false;
@@ -42,10 +42,20 @@
 
 typename TwoDBeaconObservationModel::ObservationType 
 TwoDBeaconObservationModel::getObservation(const ompl::base::State *state, bool isSimulation)
+{
+    ObservationType z;
+
+    this->getObservation(state, isSimulation, z);
+
+    return z;
+}
+
+void TwoDBeaconObservationModel::getObservation(const ompl::base::State *state, bool isSimulation, ObservationType &z)
 {
 	using namespace arma;
 
-    ObservationType z;
+    // every beacon is always observed, so the size is known up front
+    z.set_size(landmarks_.size()*singleObservationDim);
 
     //generate observation from state, and corrupt with the given noise
     for(unsigned int i = 0; i < landmarks_.size(); i++)
@@ -54,8 +64,6 @@ TwoDBeaconObservationModel::getObservation(const ompl::base::State *state, bool
         double range =0;
 
         calculateRangeToLandmark(state, landmarks_[i], range);
-        
-        z.resize((i+1)*singleObservationDim ,  1);
 
         colvec noise = zeros<colvec>(obsNoiseDim);
 
@@ -79,8 +87,6 @@ TwoDBeaconObservationModel::getObservation(const ompl::base::State *state, bool
 
         z[singleObservationDim*i] = 1.0/(pow(range,2)+1) + noise(0);        
     }
-
- 	return z;
 }
 
 typename TwoDBeaconObservationModel::ObservationType 
@@ -88,7 +94,7 @@ TwoDBeaconObservationModel::getObservationPrediction(const ompl::base::State *st
 {
 	using namespace arma;
 
-    ObservationType z;
+    ObservationType z(landmarks_.size()*singleObservationDim);
 
     //generate observation from predicted state
     for(unsigned int i = 0; i < landmarks_.size(); i++)
@@ -97,8 +103,6 @@ TwoDBeaconObservationModel::getObservationPrediction(const ompl::base::State *st
         double range =0;
 
         calculateRangeToLandmark(state, landmarks_[i], range);
-        
-        z.resize((i+1)*singleObservationDim ,  1);
 
         z[singleObservationDim*i] = 1/(pow(range,2)+1);        
     }
@@ -40,6 +40,11 @@
 #include "ompl/datastructures/PDF.h"
 #include "ompl/tools/config/SelfConfig.h"
 #include "ompl/tools/config/MagicConstants.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <queue>
+#include <set>
 #include <boost/lambda/bind.hpp>
 #include <boost/graph/astar_search.hpp>
 #include <boost/graph/incremental_components.hpp>
@@ -49,6 +54,10 @@
 #include <tinyxml.h>
 #include "Visualization/Visualizer.h"
 #include "Utils/FIRMUtils.h"
+#include "Utils/AllocationScope.h"
+#include "Filters/dare.h"
+#include "Samplers/UniformValidBeliefSampler.h"
+#include "Samplers/GaussianValidBeliefSampler.h"
 #include "Planner/FIRM.h"
 
 #define foreach BOOST_FOREACH
@@ -74,6 +83,9 @@ namespace ompl
         /** \brief For a node that is not observable, use a fixed covariance */
         static const double NON_OBSERVABLE_NODE_COVARIANCE = 0.1; // 0.1 is a good number
 
+        /** \brief Number of loaded nodes whose stationary covariances are solved as one warm started DARE batch */
+        static const unsigned int NODE_DARE_BATCH_SIZE = 32;
+
         /** \brief Discounting factor for the Dynamic Programming solution, helps converge faster if set < 1.0 */
         static const float DEFAULT_DP_DISCOUNT_FACTOR = 1.0;
 
@@ -115,6 +127,18 @@ namespace ompl
         static const int DEFAULT_STEPS_TO_ROLLOUT = 10;
 
         static const double EDGE_COST_BIAS = 0.01; // In controller.h all edge costs are added up from 0.01 as the starting cost, this helps DP converge
+
+        /** \brief Number of times a roadmap path for NBM3P is searched again after finding an invalid edge on it */
+        static const unsigned int MAX_ROADMAP_PATH_REPAIRS = 10;
+
+        /** \brief Default number of heading sectors in the observability map of the belief samplers */
+        static const unsigned int DEFAULT_OBSERVABILITY_MAP_HEADINGS = 8;
+
+        /** \brief Side of a cell of the grid the edges are filed in */
+        static const double EDGE_GRID_CELL_SIZE = 1.0; // meters
+
+        /** \brief The bounding box of an edge is grown by this much to cover the robot and its deviation from the edge */
+        static const double EDGE_SWEPT_MARGIN = 0.5; // meters
     }
 }
 
@@ -150,6 +174,8 @@ FIRM::FIRM(const firm::SpaceInformation::SpaceInformationPtr &si, bool debugMode
 
     policyExecutionSI_ = siF_; // by default policies are executed in the same space that the roadmap is generated
 
+    edgeGrid_ = std::make_shared<firm::EdgeGrid>(ompl::magic::EDGE_GRID_CELL_SIZE);
+
     logFilePath_ = "./";
 
     loadedRoadmapFromFile_ = false;
@@ -251,6 +277,7 @@ void FIRM::clear(void)
         nn_->clear();
     clearQuery();
     maxEdgeID_ = 0;
+    edgeGrid_->clear();
 }
 
 void FIRM::freeMemory(void)
@@ -315,6 +342,8 @@ void FIRM::expandRoadmap(const ompl::base::PlannerTerminationCondition &ptc,
                 successfulConnectionAttemptsProperty_[m] = 0;
                 disjointSets_.make_set(m);
 
+                journalNode(m);
+
                 // add the edge to the parent vertex
                 bool addedEdgeVM, addedEdgeMV;
 
@@ -322,6 +351,12 @@ void FIRM::expandRoadmap(const ompl::base::PlannerTerminationCondition &ptc,
 
                 addEdgeToGraph(m,v, addedEdgeMV);
 
+                if(addedEdgeVM)
+                    journalEdge(v, m);
+
+                if(addedEdgeMV)
+                    journalEdge(m, v);
+
                 if(addedEdgeVM && addedEdgeMV)
                 {
                     uniteComponents(v, m);
@@ -346,12 +381,20 @@ void FIRM::expandRoadmap(const ompl::base::PlannerTerminationCondition &ptc,
 
                 addEdgeToGraph(last,v, addedEdgeB);
 
+                if(addedEdgeA)
+                    journalEdge(v, last);
+
+                if(addedEdgeB)
+                    journalEdge(last, v);
+
                 if( addedEdgeA && addedEdgeB)
                 {
                     uniteComponents(v, last);
                 }
             }
 
+            compactJournalIfNeeded();
+
             graphMutex_.unlock();
 
         }
@@ -601,6 +644,9 @@ ompl::base::PlannerStatus FIRM::solve(const ompl::base::PlannerTerminationCondit
         this->savePlannerData();
     }
 
+    if(journal_)
+        journal_->flush();
+
     slnThread.join();
 
     OMPL_INFORM("%s: Created %u states", getName().c_str(), boost::num_vertices(g_) - nrStartStates);
@@ -672,6 +718,10 @@ FIRM::Vertex FIRM::addStateToGraph(ompl::base::State *state, bool addReverseEdge
 
     nn_->add(m);
 
+    // virtual states added during rollout are removed again, so only real nodes go to the journal
+    if(addReverseEdge)
+        journalNode(m);
+
     // Which milestones will we attempt to connect to?
     std::vector<Vertex> neighbors = connectionStrategy_(m);
 
@@ -741,6 +791,10 @@ FIRM::Vertex FIRM::addStateToGraph(ompl::base::State *state, bool addReverseEdge
 
                             uniteComponents(m, n);
 
+                            journalEdge(m, n);
+
+                            journalEdge(n, m);
+
                             Visualizer::addGraphEdge(stateProperty_[m], stateProperty_[n]);
 
                             Visualizer::addGraphEdge(stateProperty_[n], stateProperty_[m]);
@@ -748,6 +802,8 @@ FIRM::Vertex FIRM::addStateToGraph(ompl::base::State *state, bool addReverseEdge
                         }
                         else
                         {
+                            unindexEdge(m, n);
+
                             boost::remove_edge(m,n,g_); // if you cannot add bidirectional edge, then keep no edge between the two nodes
                         }
                     }
@@ -757,7 +813,10 @@ FIRM::Vertex FIRM::addStateToGraph(ompl::base::State *state, bool addReverseEdge
         }
     }
 
-    policyGenerator_->addFIRMNodeToObservationGraph(state);
+    policyGenerator_->addFIRMNodeToObservationGraph(state, m);
+
+    if(addReverseEdge)
+        compactJournalIfNeeded();
 
     return m;
 }
@@ -842,13 +901,49 @@ void FIRM::addEdgeToGraph(const FIRM::Vertex a, const FIRM::Vertex b, bool &edge
 
     edgeControllers_[newEdge.first] = edgeController;
 
+    indexEdge(a, b);
+
     edgeAdded = true;
 }
 
+void FIRM::indexEdge(const FIRM::Vertex a, const FIRM::Vertex b)
+{
+    double minX, minY, maxX, maxY;
+
+    edgeBounds(a, b, minX, minY, maxX, maxY);
+
+    edgeGrid_->insert(a, b, minX, minY, maxX, maxY);
+}
+
+void FIRM::unindexEdge(const FIRM::Vertex a, const FIRM::Vertex b)
+{
+    double minX, minY, maxX, maxY;
+
+    edgeBounds(a, b, minX, minY, maxX, maxY);
+
+    edgeGrid_->remove(a, b, minX, minY, maxX, maxY);
+}
+
+void FIRM::edgeBounds(const FIRM::Vertex a, const FIRM::Vertex b, double &minX, double &minY, double &maxX, double &maxY)
+{
+    const SE2BeliefSpace::StateType *from = stateProperty_[a]->as<SE2BeliefSpace::StateType>();
+    const SE2BeliefSpace::StateType *to = stateProperty_[b]->as<SE2BeliefSpace::StateType>();
+
+    const double margin = ompl::magic::EDGE_SWEPT_MARGIN;
+
+    minX = std::min(from->getX(), to->getX()) - margin;
+    minY = std::min(from->getY(), to->getY()) - margin;
+    maxX = std::max(from->getX(), to->getX()) + margin;
+    maxY = std::max(from->getY(), to->getY()) + margin;
+}
+
 FIRMWeight FIRM::generateEdgeControllerWithCost(const FIRM::Vertex a, const FIRM::Vertex b, EdgeControllerType &edgeController)
 {
-    ompl::base::State* startNodeState = siF_->cloneState(stateProperty_[a]);
-    ompl::base::State* targetNodeState = siF_->cloneState(stateProperty_[b]);
+    // temporary states for this edge and its particles are released together at the end
+    firm::AllocationScope scope(siF_);
+
+    ompl::base::State* startNodeState = scope.cloneState(stateProperty_[a]);
+    ompl::base::State* targetNodeState = scope.cloneState(stateProperty_[b]);
 
      // Generate the edge controller for given start and end state
     generateEdgeController(startNodeState,targetNodeState,edgeController);
@@ -862,15 +957,22 @@ FIRMWeight FIRM::generateEdgeControllerWithCost(const FIRM::Vertex a, const FIRM
     // if want/do not want to show monte carlo sim
     siF_->showRobotVisualization(SHOW_MONTE_CARLO);
 
+    // every particle leaves at the time the robot is at now, so scheduled obstacles are where they will be during the edge
+    const double startTime = policyExecutionSI_->getSimulationTime();
+
+    const double previousTime = siF_->getSimulationTime();
+
+    // the end state of the controller, every particle overwrites it
+    ompl::base::State* endBelief = scope.allocState();
+
     for(unsigned int i=0; i< numMCParticles_;i++)
     {
+        siF_->setSimulationTime(startTime);
 
         siF_->setTrueState(startNodeState);
 
         siF_->setBelief(startNodeState);
 
-        ompl::base::State* endBelief = siF_->allocState(); // allocate the end state of the controller
-
         ompl::base::Cost filteringCost(0);
 
         int stepsExecuted = 0;
@@ -887,6 +989,8 @@ FIRMWeight FIRM::generateEdgeControllerWithCost(const FIRM::Vertex a, const FIRM
         }
     }
 
+    siF_->setSimulationTime(previousTime);
+
     siF_->showRobotVisualization(true);
 
     //edgeCost.v = edgeCost.v / successCount ;
@@ -932,19 +1036,15 @@ void FIRM::generateEdgeController(const ompl::base::State *start, const ompl::ba
 
 void FIRM::generateNodeController(ompl::base::State *state, FIRM::NodeControllerType &nodeController)
 {
-    // Create a copy of the node state
-    ompl::base::State *node = si_->allocState();
-    siF_->copyState(node, state);
-
     arma::mat stationaryCovariance; 
 
-   if(siF_->getObservationModel()->isStateObservable(node))
+   if(siF_->getObservationModel()->isStateObservable(state))
    {
         // Contruct a linear kalman filter
         LinearizedKF linearizedKF(siF_);
 
         //Construct a linear system
-        LinearSystem linearSystem(siF_, node, siF_->getMotionModel()->getZeroControl(),siF_->getObservationModel()->getObservation(state, false), siF_->getMotionModel(), siF_->getObservationModel());
+        LinearSystem linearSystem(siF_, state, siF_->getMotionModel()->getZeroControl(),siF_->getObservationModel()->getObservation(state, false), siF_->getMotionModel(), siF_->getObservationModel());
 
         // Compute the stationary cov at node state using LKF
         stationaryCovariance = linearizedKF.computeStationaryCovariance(linearSystem);
@@ -957,6 +1057,15 @@ void FIRM::generateNodeController(ompl::base::State *state, FIRM::NodeController
         stationaryCovariance = arma::eye(stateDim,stateDim)*ompl::magic::NON_OBSERVABLE_NODE_COVARIANCE;
     }
 
+    generateNodeController(state, stationaryCovariance, nodeController);
+}
+
+void FIRM::generateNodeController(ompl::base::State *state, const arma::mat &stationaryCovariance, FIRM::NodeControllerType &nodeController)
+{
+    // Create a copy of the node state
+    ompl::base::State *node = si_->allocState();
+    siF_->copyState(node, state);
+
     // set the covariance
     node->as<FIRM::StateType>()->setCovariance(stationaryCovariance);
     state->as<FIRM::StateType>()->setCovariance(stationaryCovariance);
@@ -1150,6 +1259,187 @@ double FIRM::evaluateSuccessProbability(const Edge currentEdge, const FIRM::Vert
     return successProb;
 }
 
+void FIRM::updateCollisionChecker(const ompl::base::StateValidityCheckerPtr &svc)
+{
+    const ompl::base::StateValidityCheckerPtr previous = si_->getStateValidityChecker();
+
+    si_->setStateValidityChecker(svc);
+    siF_->setStateValidityChecker(svc);
+    policyExecutionSI_->setStateValidityChecker(svc);
+
+    const bool sameObservationModel = policyExecutionSI_->getObservationModel() == siF_->getObservationModel();
+
+    // which cells the samplers draw from depends on the obstacles
+    if(observabilityMap_)
+        observabilityMap_->build();
+
+    if(!previous || previous == svc)
+    {
+        // nothing to compare with, line of sight to the landmarks may have changed anywhere
+        siF_->getObservationModel()->clearVisibilityCache();
+
+        if(!sameObservationModel)
+            policyExecutionSI_->getObservationModel()->clearVisibilityCache();
+
+        return;
+    }
+
+    arma::mat changedRegions;
+
+    findChangedRegions(previous, svc, changedRegions);
+
+    // so does line of sight through the changed regions
+    siF_->getObservationModel()->clearVisibilityCache(changedRegions);
+
+    if(!sameObservationModel)
+        policyExecutionSI_->getObservationModel()->clearVisibilityCache(changedRegions);
+
+    revalidateChangedEdges(changedRegions);
+}
+
+void FIRM::findChangedRegions(const ompl::base::StateValidityCheckerPtr &previous, const ompl::base::StateValidityCheckerPtr &current,
+                              arma::mat &changedRegions)
+{
+    const double cellSize = ompl::magic::EDGE_GRID_CELL_SIZE;
+
+    const double halfDiagonal = 0.5*std::sqrt(2.0)*cellSize;
+
+    ompl::base::RealVectorBounds bounds = siF_->getStateSpace()->as<SE2BeliefSpace>()->getBounds();
+
+    // the cells are those of the edge grid, one more on every side covers the robot's reach past the bounds
+    const int x0 = std::floor(bounds.low[0] / cellSize) - 1;
+    const int x1 = std::floor(bounds.high[0] / cellSize) + 1;
+    const int y0 = std::floor(bounds.low[1] / cellSize) - 1;
+    const int y1 = std::floor(bounds.high[1] / cellSize) + 1;
+
+    std::vector<std::pair<int, int> > changedCells;
+
+    ompl::base::State *state = si_->allocState();
+
+    // An obstacle that lies in a cell, before or after the change, is within half the cell diagonal of the cell
+    // center, and the robot placed at the center is no farther from it than the center. So a cell in which neither
+    // checker reports less clearance than that is free on both sides of the change, whatever the heading and however
+    // small the obstacles. The other cells are treated as changed.
+    for(int x = x0; x <= x1; x++)
+    {
+        for(int y = y0; y <= y1; y++)
+        {
+            state->as<SE2BeliefSpace::StateType>()->setXYYaw((x + 0.5)*cellSize, (y + 0.5)*cellSize, 0);
+
+            if(previous->clearance(state) >= halfDiagonal && current->clearance(state) >= halfDiagonal)
+                continue;
+
+            changedCells.push_back(std::make_pair(x, y));
+        }
+    }
+
+    si_->freeState(state);
+
+    changedRegions.set_size(4, changedCells.size());
+
+    for(unsigned int i = 0; i < changedCells.size(); i++)
+    {
+        changedRegions(0, i) = changedCells[i].first*cellSize;
+        changedRegions(1, i) = changedCells[i].second*cellSize;
+        changedRegions(2, i) = (changedCells[i].first + 1)*cellSize;
+        changedRegions(3, i) = (changedCells[i].second + 1)*cellSize;
+    }
+}
+
+void FIRM::revalidateChangedEdges(const arma::mat &changedRegions)
+{
+    if(edgeGrid_->empty())
+        return;
+
+    std::vector<firm::EdgeGrid::VertexPair> affected, edges;
+
+    const unsigned int numChangedCells = changedRegions.n_cols;
+
+    // the swept margin of the edge boxes covers the robot's reach out of the edges that pass a changed cell
+    for(unsigned int i = 0; i < numChangedCells; i++)
+    {
+        // query the center so the neighbouring cells that share its border are left out
+        const double centerX = 0.5*(changedRegions(0, i) + changedRegions(2, i));
+        const double centerY = 0.5*(changedRegions(1, i) + changedRegions(3, i));
+
+        edgeGrid_->query(centerX, centerY, centerX, centerY, edges);
+
+        affected.insert(affected.end(), edges.begin(), edges.end());
+    }
+
+    std::sort(affected.begin(), affected.end());
+
+    affected.erase(std::unique(affected.begin(), affected.end()), affected.end());
+
+    unsigned int numBlocked = 0, numRestored = 0;
+
+    // simulating a restored edge moves the true state, which the robot may be executing from
+    ompl::base::State *trueState = si_->allocState();
+
+    siF_->getTrueState(trueState);
+
+    {
+        boost::mutex::scoped_lock _(graphMutex_);
+
+        for(unsigned int k = 0; k < affected.size(); k++)
+        {
+            const Vertex a = affected[k].first;
+            const Vertex b = affected[k].second;
+
+            // the grid keeps edges that were removed from the roadmap since
+            std::pair<Edge, bool> edge = boost::edge(a, b, g_);
+
+            if(!edge.second)
+                continue;
+
+            const bool wasBlocked = weightProperty_[edge.first].getSuccessProbability() == 0;
+
+            const bool isFree = si_->checkMotion(stateProperty_[a], stateProperty_[b]);
+
+            if(isFree && wasBlocked)
+            {
+                // the obstacle that blocked the edge is gone, simulate the edge again for its cost and success probability
+                EdgeControllerType edgeController;
+
+                const FIRMWeight weight = generateEdgeControllerWithCost(a, b, edgeController);
+
+                // FIRMWeight's assignment only copies the cost
+                weightProperty_[edge.first].setCost(weight.getCost());
+
+                weightProperty_[edge.first].setSuccessProbability(weight.getSuccessProbability());
+
+                edgeControllers_[edge.first] = edgeController;
+
+                journalEdgeWeight(edge.first);
+
+                numRestored++;
+            }
+            else if(!isFree && !wasBlocked)
+            {
+                weightProperty_[edge.first].setCost(weightProperty_[edge.first].getCost() + obstacleCostToGo_*10);
+
+                weightProperty_[edge.first].setSuccessProbability(0.0);
+
+                journalEdgeWeight(edge.first);
+
+                numBlocked++;
+            }
+        }
+    }
+
+    if(numRestored > 0)
+        siF_->setTrueState(trueState);
+
+    si_->freeState(trueState);
+
+    OMPL_INFORM("FIRM: Obstacles may have changed in %u cells, of %u edges passing them %u are blocked and %u are free again",
+                numChangedCells, (unsigned int)affected.size(), numBlocked, numRestored);
+
+    // one repair for every edge that changed, instead of one per edge found while executing the policy
+    if(numBlocked + numRestored > 0 && !goalM_.empty())
+        solveDynamicProgram(goalM_[0]);
+}
+
 void FIRM::updateEdgeCollisionCost(FIRM::Vertex currentVertex, FIRM::Vertex goalVertex)
 {
     // cycle through feedback, update edge costs for edges in collision
@@ -1168,6 +1458,8 @@ void FIRM::updateEdgeCollisionCost(FIRM::Vertex currentVertex, FIRM::Vertex goal
 
             weightProperty_[edge].setSuccessProbability(0.0);
 
+            journalEdgeWeight(edge);
+
             // Get outgoing edges of target
             foreach(Edge e, boost::out_edges(target, g_))
             {
@@ -1179,6 +1471,8 @@ void FIRM::updateEdgeCollisionCost(FIRM::Vertex currentVertex, FIRM::Vertex goal
                     weightProperty_[e].setCost(pvc2 + obstacleCostToGo_*10);
 
                     weightProperty_[e].setSuccessProbability(0.0);
+
+                    journalEdgeWeight(e);
                 }
             }
 
@@ -1275,7 +1569,7 @@ void FIRM::executeFeedback(void)
 
         siF_->getTrueState(tempTrueStateCopy);
 
-        if(!si_->isValid(tempTrueStateCopy))
+        if(!siF_->isValidAtTime(tempTrueStateCopy, policyExecutionSI_->getSimulationTime()))
         {
            OMPL_INFORM("Robot Collided :(");
 
@@ -1411,7 +1705,7 @@ void FIRM::executeFeedbackWithKidnapping(void)
 
         siF_->getTrueState(tempTrueStateCopy);
 
-        if(!si_->isValid(tempTrueStateCopy))
+        if(!siF_->isValidAtTime(tempTrueStateCopy, policyExecutionSI_->getSimulationTime()))
         {
             OMPL_INFORM("Robot Collided :(");
             return;
@@ -1511,7 +1805,10 @@ void FIRM::executeFeedbackWithRollout(void)
 
     sendMostLikelyPathToViz(start, goal) ;
 
-    ompl::base::State *goalState = si_->cloneState(stateProperty_[goal]);
+    // the states used while executing are released together when execution ends, also if the robot collides
+    firm::AllocationScope scope(siF_);
+
+    ompl::base::State *goalState = scope.cloneState(stateProperty_[goal]);
 
     //===== SET A Custom Init Covariance=====================
     // using namespace arma;
@@ -1531,10 +1828,11 @@ void FIRM::executeFeedbackWithRollout(void)
 
     Vertex currentVertex =  start;
 
-    ompl::base::State *cstartState = si_->allocState();
-    si_->copyState(cstartState, stateProperty_[start]);
+    ompl::base::State *cstartState = scope.cloneState(stateProperty_[start]);
 
-    ompl::base::State *cendState = si_->allocState();
+    ompl::base::State *cendState = scope.allocState();
+
+    ompl::base::State *tState = scope.allocState();
 
     OMPL_INFORM("FIRM: Running policy execution");
 
@@ -1586,11 +1884,9 @@ void FIRM::executeFeedbackWithRollout(void)
 
         costToGoHistory_.push_back(std::make_pair(currentTimeStep_, executionCost_));
 
-        ompl::base::State *tState = si_->allocState();
-
         siF_->getTrueState(tState);
 
-        if(!si_->isValid(tState))
+        if(!siF_->isValidAtTime(tState, policyExecutionSI_->getSimulationTime()))
         {
             OMPL_INFORM("Robot Collided :(");
             return;
@@ -1658,12 +1954,16 @@ void FIRM::executeFeedbackWithRollout(void)
 
             Visualizer::setChosenRolloutConnection(stateProperty_[tempVertex], stateProperty_[boost::target(e,g_)]);
 
+            // the next rollout vertex reuses this id, its edges must not stay in the edge grid
+            foreach(Edge out, boost::out_edges(tempVertex, g_))
+            {
+                unindexEdge(tempVertex, boost::target(out, g_));
+            }
+
             boost::remove_vertex(tempVertex, g_);
 
         }
 
-        si_->freeState(tState);
-
         si_->copyState(cstartState, cendState);
 
     }
@@ -1716,7 +2016,8 @@ void FIRM::showRolloutConnections(const FIRM::Vertex v)
         Visualizer::addRolloutConnection(stateProperty_[v], stateProperty_[n]);
     }
 
-    boost::this_thread::sleep(boost::posix_time::milliseconds(50));
+    if(Visualizer::isEnabled())
+        boost::this_thread::sleep(boost::posix_time::milliseconds(50));
 }
 
 void FIRM::addStateToVisualization(const ompl::base::State *state)
@@ -1881,9 +2182,17 @@ bool FIRM::detectKidnapping(ompl::base::State *previousState, ompl::base::State
 
 void FIRM::savePlannerData()
 {
-
     std::vector<std::pair<int,std::pair<arma::colvec,arma::mat> > > nodes;
 
+    std::vector<std::pair<std::pair<int,int>,FIRMWeight> > edgeWeights;
+
+    getRoadmapSnapshot(nodes, edgeWeights);
+
+    FIRMUtils::writeFIRMGraphToXML(nodes, edgeWeights);
+}
+
+void FIRM::getRoadmapSnapshot(firm::RoadmapJournal::NodeList &nodes, firm::RoadmapJournal::EdgeList &edgeWeights)
+{
     foreach(Vertex v, boost::vertices(g_))
     {
 
@@ -1897,8 +2206,6 @@ void FIRM::savePlannerData()
 
     }
 
-    std::vector<std::pair<std::pair<int,int>,FIRMWeight> > edgeWeights;
-
     foreach(Edge e, boost::edges(g_))
     {
         Vertex start = boost::source(e,g_);
@@ -1909,11 +2216,184 @@ void FIRM::savePlannerData()
         edgeWeights.push_back(std::make_pair(std::make_pair(start,goal),w));
 
     }
+}
 
-    FIRMUtils::writeFIRMGraphToXML(nodes, edgeWeights);
+void FIRM::setObservabilityMap(const double resolution, const unsigned int numHeadings, const bool gaussian)
+{
+    observabilityMap_ = std::make_shared<firm::ObservabilityMap>(siF_, resolution, numHeadings);
+
+    observabilityMap_->build();
+
+    std::shared_ptr<const firm::ObservabilityMap> map = observabilityMap_;
+
+    if(gaussian)
+    {
+        siF_->setValidStateSamplerAllocator([map](const ompl::base::SpaceInformation *si)
+        {
+            std::shared_ptr<GaussianValidBeliefSampler> sampler = std::make_shared<GaussianValidBeliefSampler>(si);
+            sampler->setObservabilityMap(map);
+            return ompl::base::ValidStateSamplerPtr(sampler);
+        });
+    }
+    else
+    {
+        siF_->setValidStateSamplerAllocator([map](const ompl::base::SpaceInformation *si)
+        {
+            std::shared_ptr<UniformValidBeliefSampler> sampler = std::make_shared<UniformValidBeliefSampler>(si);
+            sampler->setObservabilityMap(map);
+            return ompl::base::ValidStateSamplerPtr(sampler);
+        });
+    }
+
+    // the next roadmap growth allocates a sampler that uses the map
+    sampler_.reset();
+}
+
+void FIRM::setRoadmapJournal(const std::string &pathToJournal)
+{
+    boost::mutex::scoped_lock _(graphMutex_);
+
+    journal_.reset(new firm::RoadmapJournal(pathToJournal));
+
+    // a journal started on top of an existing roadmap needs that roadmap as its base
+    if(boost::num_vertices(g_) > 0)
+    {
+        firm::RoadmapJournal::NodeList nodes;
+        firm::RoadmapJournal::EdgeList edgeWeights;
+
+        getRoadmapSnapshot(nodes, edgeWeights);
+
+        journal_->compact(nodes, edgeWeights);
+    }
+}
+
+void FIRM::journalNode(const Vertex v)
+{
+    if(!journal_)
+        return;
+
+    journal_->appendNode(v, stateProperty_[v]->as<FIRM::StateType>()->getArmaData(), stateProperty_[v]->as<FIRM::StateType>()->getCovariance());
+}
+
+void FIRM::journalEdge(const Vertex a, const Vertex b)
+{
+    if(!journal_)
+        return;
+
+    std::pair<Edge, bool> edge = boost::edge(a, b, g_);
+
+    if(edge.second)
+        journal_->appendEdge(a, b, weightProperty_[edge.first]);
+}
+
+void FIRM::journalEdgeWeight(const Edge e)
+{
+    if(!journal_)
+        return;
 
+    journal_->appendEdgeWeight(boost::source(e, g_), boost::target(e, g_), weightProperty_[e]);
 }
 
+void FIRM::compactJournalIfNeeded()
+{
+    if(!journal_ || !journal_->needsCompaction())
+        return;
+
+    firm::RoadmapJournal::NodeList nodes;
+    firm::RoadmapJournal::EdgeList edgeWeights;
+
+    getRoadmapSnapshot(nodes, edgeWeights);
+
+    journal_->compact(nodes, edgeWeights);
+}
+
+void FIRM::computeStationaryCovariances(const std::vector<ompl::base::State*> &states, std::vector<arma::mat> &stationaryCovariances)
+{
+    const unsigned int numStates = states.size();
+
+    stationaryCovariances.assign(numStates, arma::mat());
+
+    if(numStates == 0)
+        return;
+
+    // Visit the states in a serpentine scan over rows of the bounding box, so consecutive DAREs come from nearby
+    // linearizations and each warm starts from the one before it.
+    double minX = std::numeric_limits<double>::max(), minY = minX, maxY = -minX;
+
+    foreach(const ompl::base::State *state, states)
+    {
+        minX = std::min(minX, state->as<FIRM::StateType>()->getX());
+        minY = std::min(minY, state->as<FIRM::StateType>()->getY());
+        maxY = std::max(maxY, state->as<FIRM::StateType>()->getY());
+    }
+
+    const unsigned int numRows = std::max(1u, (unsigned int)std::ceil(std::sqrt((double)numStates)));
+
+    const double rowHeight = std::max((maxY - minY) / numRows, std::numeric_limits<double>::epsilon());
+
+    std::vector<std::pair<std::pair<unsigned int, double>, unsigned int> > scan(numStates);
+
+    for(unsigned int i = 0; i < numStates; i++)
+    {
+        const unsigned int row = std::min(numRows - 1, (unsigned int)((states[i]->as<FIRM::StateType>()->getY() - minY) / rowHeight));
+
+        const double x = states[i]->as<FIRM::StateType>()->getX() - minX;
+
+        scan[i] = std::make_pair(std::make_pair(row, row % 2 ? -x : x), i);
+    }
+
+    std::sort(scan.begin(), scan.end());
+
+    // Batches are contiguous runs of the scan and are solved in parallel
+    const unsigned int numBatches = (numStates + ompl::magic::NODE_DARE_BATCH_SIZE - 1) / ompl::magic::NODE_DARE_BATCH_SIZE;
+
+    FIRMUtils::parallelFor(numBatches, [&](unsigned int b)
+    {
+        const unsigned int begin = b*ompl::magic::NODE_DARE_BATCH_SIZE;
+        const unsigned int end = std::min(numStates, begin + ompl::magic::NODE_DARE_BATCH_SIZE);
+
+        LinearizedKF linearizedKF(siF_);
+
+        std::vector<unsigned int> observable;
+        std::vector<LinearSystem> linearSystems;
+        std::vector<arma::mat> As, Bs, Qs, Rs;
+
+        for(unsigned int k = begin; k < end; k++)
+        {
+            ompl::base::State *state = states[scan[k].second];
+
+            if(!siF_->getObservationModel()->isStateObservable(state))
+            {
+                // set a default stationary cov at node state
+                const int stateDim = si_->getStateDimension();
+
+                stationaryCovariances[scan[k].second] = arma::eye(stateDim,stateDim)*ompl::magic::NON_OBSERVABLE_NODE_COVARIANCE;
+
+                continue;
+            }
+
+            linearSystems.push_back(LinearSystem(siF_, state, siF_->getMotionModel()->getZeroControl(),siF_->getObservationModel()->getObservation(state, false), siF_->getMotionModel(), siF_->getObservationModel()));
+
+            As.push_back(arma::mat()); Bs.push_back(arma::mat()); Qs.push_back(arma::mat()); Rs.push_back(arma::mat());
+
+            LinearizedKF::stationaryRiccatiProblem(linearSystems.back(), As.back(), Bs.back(), Qs.back(), Rs.back());
+
+            observable.push_back(scan[k].second);
+        }
+
+        std::vector<arma::mat> stationaryPredictions;
+        std::vector<bool> solved;
+
+        dareBatch(As, Bs, Qs, Rs, stationaryPredictions, solved);
+
+        for(unsigned int j = 0; j < observable.size(); j++)
+        {
+            // an unsolved problem goes through the plain solver, which reports the failure
+            stationaryCovariances[observable[j]] = solved[j] ? linearizedKF.computeStationaryCovariance(linearSystems[j], stationaryPredictions[j])
+                                                             : linearizedKF.computeStationaryCovariance(linearSystems[j]);
+        }
+    });
+}
 
 void FIRM::loadRoadMapFromFile(const std::string &pathToFile)
 {
@@ -1922,43 +2402,61 @@ void FIRM::loadRoadMapFromFile(const std::string &pathToFile)
 
     boost::mutex::scoped_lock _(graphMutex_);
 
-    if(FIRMUtils::readFIRMGraphFromXML(pathToFile,  FIRMNodePosList, FIRMNodeCovarianceList , loadedEdgeProperties_))
+    // a journal is replayed on top of its last snapshot, anything else is a plain XML roadmap
+    const bool isJournal = firm::RoadmapJournal::isJournal(pathToFile);
+
+    const bool loaded = isJournal ? firm::RoadmapJournal::replay(pathToFile, FIRMNodePosList, FIRMNodeCovarianceList, loadedEdgeProperties_)
+                                  : FIRMUtils::readFIRMGraphFromXML(pathToFile,  FIRMNodePosList, FIRMNodeCovarianceList , loadedEdgeProperties_);
+
+    if(loaded)
     {
 
         loadedRoadmapFromFile_ = true;
 
         this->setup();
 
-        for(int i = 0; i < FIRMNodePosList.size() ; i++)
-        {
-            ompl::base::State *newState = siF_->allocState();
+        const unsigned int numNodes = FIRMNodePosList.size();
+
+        std::vector<ompl::base::State*> nodeStates(numNodes);
 
-            arma::colvec xVec = FIRMNodePosList[i].second;
-            arma::mat     cov = FIRMNodeCovarianceList[i].second;
+        std::vector<NodeControllerType> nodeControllers(numNodes);
 
-            newState->as<FIRM::StateType>()->setArmaData(xVec);
-            newState->as<FIRM::StateType>()->setCovariance(cov);
+        for(unsigned int i = 0; i < numNodes; i++)
+        {
+            nodeStates[i] = siF_->allocState();
 
-            //Vertex v = addStateToGraph(siF_->cloneState(newState));
+            nodeStates[i]->as<FIRM::StateType>()->setArmaData(FIRMNodePosList[i].second);
+            nodeStates[i]->as<FIRM::StateType>()->setCovariance(FIRMNodeCovarianceList[i].second);
+        }
 
-            Vertex m;
+        std::vector<arma::mat> stationaryCovariances;
 
-            m = boost::add_vertex(g_);
+        computeStationaryCovariances(nodeStates, stationaryCovariances);
 
-            stateProperty_[m] = newState;
+        // Node controllers are independent of each other and of the graph, so compute them all in parallel
+        // before touching the graph.
+        FIRMUtils::parallelFor(numNodes, [&](unsigned int i)
+        {
+            generateNodeController(nodeStates[i], stationaryCovariances[i], nodeControllers[i]); // Generate the node controller
+        });
 
-            NodeControllerType nodeController;
+        // Commit the precomputed nodes to the graph in a single pass
+        for(unsigned int i = 0; i < numNodes; i++)
+        {
+            ompl::base::State *newState = nodeStates[i];
 
-            generateNodeController(newState, nodeController); // Generate the node controller
+            Vertex m = boost::add_vertex(g_);
 
-            nodeControllers_[m] = nodeController; // Add it to the list
+            stateProperty_[m] = newState;
+
+            nodeControllers_[m] = nodeControllers[i]; // Add it to the list
 
             // Initialize to its own (dis)connected component.
             disjointSets_.make_set(m);
 
             nn_->add(m);
 
-            policyGenerator_->addFIRMNodeToObservationGraph(newState);
+            policyGenerator_->addFIRMNodeToObservationGraph(newState, m);
 
             addStateToVisualization(newState);
 
@@ -1991,6 +2489,8 @@ void FIRM::loadRoadMapFromFile(const std::string &pathToFile)
 
             edgeControllers_[newEdge.first] = edgeController;
 
+            indexEdge(a, b);
+
             if(unite)
                 uniteComponents(a, b);
 
@@ -2000,6 +2500,22 @@ void FIRM::loadRoadMapFromFile(const std::string &pathToFile)
 
         }
 
+        // unless we just replayed our own journal, it does not know about the loaded roadmap yet
+        boost::system::error_code ec;
+
+        if(journal_ && !(isJournal && boost::filesystem::equivalent(pathToFile, journal_->getPath(), ec)))
+        {
+            firm::RoadmapJournal::NodeList nodes;
+            firm::RoadmapJournal::EdgeList edgeWeights;
+
+            getRoadmapSnapshot(nodes, edgeWeights);
+
+            journal_->compact(nodes, edgeWeights);
+        }
+
+        // the signature index is stored alongside the roadmap, so it only has to be built once per environment
+        policyGenerator_->loadObservationSignatureIndex(pathToFile + ".signatures");
+
     }
 }
 
@@ -2146,6 +2662,67 @@ void FIRM::loadParametersFromFile(const std::string &pathToFile)
         doSavePlannerData_ = false;
     }
 
+    // optional journal of the roadmap as it is built
+    std::string journalPath;
+    if(itemElement->QueryStringAttribute("journal", &journalPath) == TIXML_SUCCESS && !journalPath.empty())
+    {
+        setRoadmapJournal(journalPath);
+    }
+
+    // optional choice of how NBM3P plans the paths for its candidate policies
+    child = node->FirstChild("NBM3P");
+
+    if(child && child->ToElement())
+    {
+        std::string pathProvider;
+        child->ToElement()->QueryStringAttribute("pathprovider", &pathProvider);
+
+        if(pathProvider == "roadmap")
+        {
+            policyGenerator_->setPathProvider(boost::bind(&FIRM::planRoadmapPath, this, _1, _2, _3, _4));
+        }
+        else if(!pathProvider.empty() && pathProvider != "rrtstar")
+        {
+            OMPL_WARN("FIRM: Unknown NBM3P path provider '%s', using RRT*", pathProvider.c_str());
+        }
+
+        double roundBudget = 0;
+        if(child->ToElement()->QueryDoubleAttribute("roundbudget", &roundBudget) == TIXML_SUCCESS && roundBudget >= 0)
+        {
+            policyGenerator_->setPolicyGenerationBudget(roundBudget);
+        }
+
+        int maxModes = 0;
+        if(child->ToElement()->QueryIntAttribute("maxmodes", &maxModes) == TIXML_SUCCESS && maxModes >= 0)
+        {
+            policyGenerator_->setMaxNumberOfModes(maxModes);
+        }
+    }
+
+    // optional raster the roadmap samples are drawn from
+    child = node->FirstChild("ObservabilityMap");
+
+    if(child && child->ToElement())
+    {
+        double resolution = 0;
+        child->ToElement()->QueryDoubleAttribute("resolution", &resolution);
+
+        int numHeadings = ompl::magic::DEFAULT_OBSERVABILITY_MAP_HEADINGS;
+        child->ToElement()->QueryIntAttribute("headings", &numHeadings);
+
+        std::string samplerName;
+        child->ToElement()->QueryStringAttribute("sampler", &samplerName);
+
+        if(resolution > 0 && numHeadings > 0)
+        {
+            setObservabilityMap(resolution, numHeadings, samplerName == "gaussian");
+        }
+        else
+        {
+            OMPL_WARN("FIRM: ObservabilityMap needs a positive resolution and number of headings, sampling the whole space");
+        }
+    }
+
     // Monte carlo parameters
     child = node->FirstChild("MCParticles");
     assert( child );
@@ -2279,6 +2856,157 @@ bool FIRM::isGoalVertex(const Vertex v)
 
 }
 
+bool FIRM::planRoadmapPath(const ompl::base::State *start, const ompl::base::State *goal, const Vertex goalVertex, ompl::geometric::PathGeometric &path)
+{
+    // the graph is only locked while it is read, the motions are checked without holding it
+    std::vector<Vertex> startNeighbors;
+
+    std::vector<const ompl::base::State*> startNeighborStates;
+
+    {
+        boost::mutex::scoped_lock _(graphMutex_);
+
+        // NBM3P keeps its own copy of the nodes, make sure the node it names is still the one at goal
+        if(goalVertex >= boost::num_vertices(g_) || si_->distance(stateProperty_[goalVertex], goal) > 1e-6)
+            return false;
+
+        // a temporary vertex lets the nearest neighbor structure search around the start, it is the last one so
+        // removing it again does not renumber any node
+        const Vertex query = boost::add_vertex(g_);
+
+        stateProperty_[query] = const_cast<ompl::base::State*>(start);
+
+        nn_->nearestR(query, NNRadius_, startNeighbors);
+
+        boost::remove_vertex(query, g_);
+
+        // nearestR returns the nodes closest first
+        startNeighbors.erase(std::remove_if(startNeighbors.begin(), startNeighbors.end(), [query](const Vertex v) { return v >= query; }),
+                             startNeighbors.end());
+
+        foreach(Vertex v, startNeighbors)
+            startNeighborStates.push_back(stateProperty_[v]);
+    }
+
+    // the search starts from every node the robot can drive to in a straight line, at the cost of getting there
+    std::vector<std::pair<Vertex, double> > startConnections;
+
+    for(unsigned int i = 0; i < startNeighbors.size() && (int)startConnections.size() < numNearestNeighbors_; i++)
+    {
+        if(si_->checkMotion(start, startNeighborStates[i]))
+            startConnections.push_back(std::make_pair(startNeighbors[i], si_->distance(start, startNeighborStates[i])));
+    }
+
+    if(startConnections.empty())
+        return false;
+
+    // edges found to be in collision since the roadmap was built
+    std::set<std::pair<Vertex, Vertex> > blockedEdges;
+
+    for(unsigned int attempt = 0; attempt <= ompl::magic::MAX_ROADMAP_PATH_REPAIRS; attempt++)
+    {
+        std::vector<Vertex> route;
+
+        std::vector<const ompl::base::State*> routeStates;
+
+        {
+            boost::mutex::scoped_lock _(graphMutex_);
+
+            const unsigned int numVertices = boost::num_vertices(g_);
+
+            // A* over the roadmap with path length as the cost, the state space distance to the goal is admissible
+            std::vector<double> costFromStart(numVertices, std::numeric_limits<double>::infinity());
+
+            std::vector<Vertex> parent(numVertices, numVertices);
+
+            std::vector<bool> closed(numVertices, false);
+
+            typedef std::pair<double, Vertex> QueueItem;
+
+            std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem> > open;
+
+            for(unsigned int i = 0; i < startConnections.size(); i++)
+            {
+                const Vertex v = startConnections[i].first;
+
+                if(v < numVertices && startConnections[i].second < costFromStart[v])
+                {
+                    costFromStart[v] = startConnections[i].second;
+                    open.push(std::make_pair(costFromStart[v] + si_->distance(stateProperty_[v], goal), v));
+                }
+            }
+
+            while(!open.empty())
+            {
+                const Vertex u = open.top().second;
+
+                open.pop();
+
+                if(closed[u])
+                    continue;
+
+                closed[u] = true;
+
+                if(u == goalVertex)
+                    break;
+
+                foreach(Edge e, boost::out_edges(u, g_))
+                {
+                    const Vertex v = boost::target(e, g_);
+
+                    // edges already known to be blocked are never worth a check
+                    if(closed[v] || weightProperty_[e].getSuccessProbability() == 0 || blockedEdges.count(std::make_pair(u, v)))
+                        continue;
+
+                    const double cost = costFromStart[u] + si_->distance(stateProperty_[u], stateProperty_[v]);
+
+                    if(cost < costFromStart[v])
+                    {
+                        costFromStart[v] = cost;
+                        parent[v] = u;
+                        open.push(std::make_pair(cost + si_->distance(stateProperty_[v], goal), v));
+                    }
+                }
+            }
+
+            if(goalVertex >= numVertices || !closed[goalVertex])
+                return false;
+
+            for(Vertex v = goalVertex; v != numVertices; v = parent[v])
+                route.push_back(v);
+
+            std::reverse(route.begin(), route.end());
+
+            foreach(Vertex v, route)
+                routeStates.push_back(stateProperty_[v]);
+        }
+
+        // roadmap edges are only rechecked when they are on a candidate route
+        bool routeIsValid = true;
+
+        for(unsigned int i = 1; i < route.size(); i++)
+        {
+            if(!si_->checkMotion(routeStates[i-1], routeStates[i]))
+            {
+                blockedEdges.insert(std::make_pair(route[i-1], route[i]));
+                routeIsValid = false;
+            }
+        }
+
+        if(!routeIsValid)
+            continue;
+
+        path = ompl::geometric::PathGeometric(si_, start);
+
+        foreach(const ompl::base::State *state, routeStates)
+            path.append(state);
+
+        return true;
+    }
+
+    return false;
+}
+
 void FIRM::recoverLostRobot(ompl::base::State *recoveredState)
 {
     Visualizer::doSaveVideo(false);
@@ -2297,8 +3025,6 @@ void FIRM::recoverLostRobot(ompl::base::State *recoveredState)
 
     std::cout << "Time to sample beliefs: "<<std::chrono::duration_cast<std::chrono::milliseconds>(end_time_sampling - start_time_sampling).count() << " milli seconds."<<std::endl;
 
-    std::cin.get();
-
     //ompl::base::State *currentTrueState = siF_->allocState();
 
     //siF_->getTrueState(currentTrueState);
@@ -2374,8 +3100,6 @@ void FIRM::recoverLostRobot(ompl::base::State *recoveredState)
 
     std::cout << "Time to sample recover (exclude sampling): "<<std::chrono::duration_cast<std::chrono::milliseconds>(end_time_recovery - start_time_recovery).count() << " milli seconds."<<std::endl;
 
-    std::cin.get();
-
     std::vector<ompl::base::State*> bstates;
 
     policyGenerator_->getCurrentBeliefStates(bstates);
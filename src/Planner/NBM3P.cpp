@@ -34,7 +34,10 @@
 
 /* Author: Saurav Agarwal */
 
+#include <algorithm>
+#include <limits>
 #include <numeric>
+#include <queue>
 #include <boost/thread.hpp>
 #include <boost/foreach.hpp>
 #include "Planner/NBM3P.h"
@@ -56,6 +59,10 @@ namespace ompl
 
         static const double RRT_PLAN_MAX_TIME = 1.0; // maximum time allowed for RRT to plan
 
+        static const double POLICY_GENERATION_MAX_TIME = 3.0; // wall clock budget shared by all the per mode RRT runs
+
+        static const double ANYTIME_PLANNING_BUDGET_FRACTION = 0.5; // share of a round's budget spent planning paths, the rest evaluates them
+
         static const double RRT_FINAL_PROXIMITY_THRESHOLD = 1.0; // maximum distance for RRT to succeed
 
         static const double NEIGHBORHOOD_RANGE = 20.0 ; // 20(6cw), 12 (4cw) range within which to find neighbors
@@ -73,6 +80,18 @@ namespace ompl
         static const double SAMPLING_ROTATION_SPACING = 5.0; // degrees
 
         static const double SAMPLING_GRID_SIZE = 0.50 ; // meters
+
+        static const double DUPLICATE_MODE_POSITION_TOLERANCE = 0.01; // meters, modes closer than this in x and y (and yaw) are merged
+
+        static const double DUPLICATE_MODE_YAW_TOLERANCE = 1.0; // degrees
+
+        static const double SIGNATURE_RANGE_BIN_SIZE = 0.5; // meters, range resolution of the observation signature index
+
+        static const double SIGNATURE_BEARING_BIN_SIZE = 20.0; // degrees, bearing resolution of the observation signature index
+
+        static const unsigned int MODE_MERGE_CANDIDATES = 8; // each mode is only considered for merging with this many nearest modes
+
+        static const unsigned int MODE_MERGE_YAW_CELLS = 8; // heading cells of the grid merge candidates are looked up in
     }
 }
 
@@ -80,31 +99,13 @@ void NBM3P::sampleNewBeliefStates()
 {
     /**
     Logic:
-    1. Grid the environment
-    2. At each point in grid, put a robot with periodic orientations (10 degree spacing)
+    1. Look up the poses consistent with what the robot sees in the observation signature index, keep the valid ones
+    2. If there is no index or no valid pose matches, grid the environment and put a robot with periodic orientations at each point
     */
     //Make sure the current states and weights are cleared out
     currentBeliefStates_.clear();
     weights_.clear();
-
-    ompl::base::StateSpacePtr sp = si_->getStateSpace();
-    ompl::base::RealVectorBounds bounds = sp->as<SE2BeliefSpace>()->getBounds();
-
-    //Get the environment boundaries
-    double X_1 = bounds.low[0];
-    double X_2 = bounds.high[0];
-    double Y_1 = bounds.low[1];
-    double Y_2 = bounds.high[1];
-
-    double spacing = ompl::magic::SAMPLING_GRID_SIZE;
-
-    // grid size
-    int gridSizeX = std::ceil( (X_2-X_1) / spacing);
-    int gridSizeY = std::ceil( (Y_2-Y_1) / spacing);
-
-    double rotationSpacing = FIRMUtils::degree2Radian(ompl::magic::SAMPLING_ROTATION_SPACING);// radians
-
-    int numHeadings = std::floor(2*boost::math::constants::pi<double>()/rotationSpacing);
+    timeSinceDivergence_.clear();
 
     arma::mat cov = arma::eye(3,3);
     cov(0,0) = 0.25;
@@ -113,32 +114,40 @@ void NBM3P::sampleNewBeliefStates()
 
     OMPL_INFORM("NBM3P: Sampling start beliefs");
 
+    arma::colvec obs = policyExecutionSI_->getObservation();
 
-    for(int i = 0; i <= gridSizeX; i++)
-    {
-        for(int j=0; j <= gridSizeY; j++)
-        {
-            double newX = X_1 + i*spacing;
-            double newY = Y_1 + j*spacing;
+    std::vector<arma::colvec> candidates;
 
-            for(int k =0; k < numHeadings; k++ )
-            {
-                double newYaw = -boost::math::constants::pi<double>() + k*rotationSpacing;
+    if(signatureIndex_)
+        signatureIndex_->query(obs, candidates);
 
-                ompl::base::State *newState = si_->allocState();
+    if(!candidates.empty())
+        OMPL_INFORM("NBM3P: %u of %u indexed poses are consistent with the observation", (unsigned int)candidates.size(), (unsigned int)signatureIndex_->size());
 
-                newState->as<SE2BeliefSpace::StateType>()->setXYYaw(newX, newY, newYaw);
-                newState->as<SE2BeliefSpace::StateType>()->setCovariance(cov);
+    foreach(const arma::colvec &xyYaw, candidates)
+    {
+        ompl::base::State *newState = si_->allocState();
 
-                if(si_->isValid(newState))
-                {
-                    currentBeliefStates_.push_back(si_->cloneState(newState));
-                    weights_.push_back(0.0); // push zero weight
-                    timeSinceDivergence_.push_back(0.0);
-                }
-                si_->freeState(newState);
-            }
+        newState->as<SE2BeliefSpace::StateType>()->setXYYaw(xyYaw[0], xyYaw[1], xyYaw[2]);
+        newState->as<SE2BeliefSpace::StateType>()->setCovariance(cov);
+
+        // obstacles may have changed since the index was built
+        if(!si_->isValid(newState))
+        {
+            si_->freeState(newState);
+            continue;
         }
+
+        currentBeliefStates_.push_back(newState);
+        weights_.push_back(0.0); // push zero weight
+        timeSinceDivergence_.push_back(0.0);
+    }
+
+    if(currentBeliefStates_.empty())
+    {
+        OMPL_INFORM("NBM3P: No valid indexed pose matches the observation, sampling the full grid");
+
+        sampleGridBeliefStates(cov);
     }
 
     OMPL_INFORM("NBM3P: Sampling beliefs Completed");
@@ -147,8 +156,6 @@ void NBM3P::sampleNewBeliefStates()
 
     OMPL_INFORM("NBM3P: Sample Belief Weights Added");
 
-    arma::colvec obs = policyExecutionSI_->getObservation();
-
     OMPL_INFORM("NBM3P: Updating the weights before proceeding");
 
     unsigned int numModes = currentBeliefStates_.size();
@@ -165,13 +172,22 @@ void NBM3P::sampleNewBeliefStates()
 
     }
 
+    // bound the number of modes every later round has to plan for and simulate
+    this->reduceModes(currentBeliefStates_, weights_, timeSinceDivergence_, maxNumberOfModes_);
+
+    // a merged mode stands for all the hypotheses it absorbed, its weight must not be reset to that of a single one
+    const bool modesMerged = currentBeliefStates_.size() < numModes;
+
     // show the beliefs
     this->drawBeliefs();
 
     this->printWeights();
 
     // After converging to most likely, assign uniform weights
-    assignUniformWeight();
+    if(modesMerged)
+        normalizeWeights();
+    else
+        assignUniformWeight();
 
     double t = 0;
 
@@ -186,7 +202,10 @@ void NBM3P::sampleNewBeliefStates()
     }
 
     // Before beginning the strategy, assign all modes the same weight
-    assignUniformWeight();
+    if(modesMerged)
+        normalizeWeights();
+    else
+        assignUniformWeight();
 
     this->printWeights();
 
@@ -201,6 +220,74 @@ void NBM3P::sampleNewBeliefStates()
 
 
 
+void NBM3P::sampleGridBeliefStates(const arma::mat &cov)
+{
+    ompl::base::StateSpacePtr sp = si_->getStateSpace();
+    ompl::base::RealVectorBounds bounds = sp->as<SE2BeliefSpace>()->getBounds();
+
+    //Get the environment boundaries
+    double X_1 = bounds.low[0];
+    double X_2 = bounds.high[0];
+    double Y_1 = bounds.low[1];
+    double Y_2 = bounds.high[1];
+
+    double spacing = ompl::magic::SAMPLING_GRID_SIZE;
+
+    // grid size
+    int gridSizeX = std::ceil( (X_2-X_1) / spacing);
+    int gridSizeY = std::ceil( (Y_2-Y_1) / spacing);
+
+    double rotationSpacing = FIRMUtils::degree2Radian(ompl::magic::SAMPLING_ROTATION_SPACING);// radians
+
+    int numHeadings = std::floor(2*boost::math::constants::pi<double>()/rotationSpacing);
+
+    for(int i = 0; i <= gridSizeX; i++)
+    {
+        for(int j=0; j <= gridSizeY; j++)
+        {
+            double newX = X_1 + i*spacing;
+            double newY = Y_1 + j*spacing;
+
+            for(int k =0; k < numHeadings; k++ )
+            {
+                double newYaw = -boost::math::constants::pi<double>() + k*rotationSpacing;
+
+                ompl::base::State *newState = si_->allocState();
+
+                newState->as<SE2BeliefSpace::StateType>()->setXYYaw(newX, newY, newYaw);
+                newState->as<SE2BeliefSpace::StateType>()->setCovariance(cov);
+
+                if(si_->isValid(newState))
+                {
+                    currentBeliefStates_.push_back(si_->cloneState(newState));
+                    weights_.push_back(0.0); // push zero weight
+                    timeSinceDivergence_.push_back(0.0);
+                }
+                si_->freeState(newState);
+            }
+        }
+    }
+}
+
+void NBM3P::loadObservationSignatureIndex(const std::string &pathToFile)
+{
+    signatureIndex_.reset(new firm::ObservationSignatureIndex(ompl::magic::SIGNATURE_RANGE_BIN_SIZE, FIRMUtils::degree2Radian(ompl::magic::SIGNATURE_BEARING_BIN_SIZE),
+                                                              ompl::magic::SAMPLING_GRID_SIZE, FIRMUtils::degree2Radian(ompl::magic::SAMPLING_ROTATION_SPACING)));
+
+    if(signatureIndex_->load(pathToFile, si_))
+    {
+        OMPL_INFORM("NBM3P: Loaded %u observation signatures from %s", (unsigned int)signatureIndex_->size(), pathToFile.c_str());
+        return;
+    }
+
+    OMPL_INFORM("NBM3P: Building the observation signature index");
+
+    signatureIndex_->build(si_);
+
+    if(!signatureIndex_->save(pathToFile))
+        OMPL_WARN("NBM3P: Could not save the observation signature index to %s", pathToFile.c_str());
+}
+
 void NBM3P::generatePolicy(std::vector<ompl::control::Control*> &policy)
 {
     si_->showRobotVisualization(false);
@@ -212,55 +299,132 @@ void NBM3P::generatePolicy(std::vector<ompl::control::Control*> &policy)
 
     std::vector<ompl::geometric::PathGeometric> rrtPaths;
 
+    // the mode each policy was planned for
+    std::vector<unsigned int> policyModes;
+
     // Iterate over the mode/target pairs and generate open loop controls
 
     auto start_time_policygen = std::chrono::high_resolution_clock::now();
 
-    for(unsigned int i = 0; i < currentBeliefStates_.size(); i++)
+    const unsigned int numModes = currentBeliefStates_.size();
+
+    // targets only depend on the modes and the graph, find them up front so the planning jobs are independent
+    std::vector<Vertex> targetVertices(numModes);
+
+    std::vector<bool> isModeValid(numModes, false);
+
+    // the neighborhoods of all modes are shared by every target search in this round
+    ModeNeighborhoods neighborhoods;
+
+    computeModeNeighborhoods(neighborhoods);
+
+    for(unsigned int i = 0; i < numModes; i++)
     {
+        isModeValid[i] = si_->isValid(currentBeliefStates_[i]);
 
-        //Generate a path for the mode/target pair
-        if( si_->isValid(currentBeliefStates_[i]) )
-        {
+        if(isModeValid[i])
+            targetVertices[i] = findTarget(i, neighborhoods);
+    }
+
+    // With a round budget, planning gets a share of it and evaluation whatever is left
+    const bool isAnytime = roundBudget_ > 0;
 
-            ompl::base::PlannerPtr planner(new ompl::geometric::RRTstar(si_));
+    const double planningTime = isAnytime ? std::min(ompl::magic::POLICY_GENERATION_MAX_TIME, ompl::magic::ANYTIME_PLANNING_BUDGET_FRACTION*roundBudget_)
+                                          : ompl::magic::POLICY_GENERATION_MAX_TIME;
 
-            ompl::base::ProblemDefinitionPtr pdef(new ompl::base::ProblemDefinition(si_));
+    auto isOverBudget = [&]()
+    {
+        return isAnytime && std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start_time_policygen).count() >= roundBudget_;
+    };
+
+    // The planning share is measured from the start of the round, so the target search and the path provider count against it
+    const ompl::base::PlannerTerminationCondition budgetPtc([&]()
+    {
+        return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start_time_policygen).count() >= planningTime;
+    });
 
-            Vertex targetVertex = findTarget(i);
+    std::vector<ompl::base::PathPtr> modePaths(numModes);
 
-            pdef->setStartAndGoalStates(currentBeliefStates_[i], stateProperty_[targetVertex], ompl::magic::RRT_FINAL_PROXIMITY_THRESHOLD);
+    // a path provider reuses work done before this round (e.g. the roadmap), RRT* is only run for the modes it cannot connect
+    if(pathProvider_)
+    {
+        for(unsigned int i = 0; i < numModes; i++)
+        {
+            if(budgetPtc() || isOverBudget())
+                break;
 
-            planner->as<ompl::geometric::RRT>()->setRange(1.0);
+            if(!isModeValid[i])
+                continue;
 
-            planner->setProblemDefinition(pdef);
+            // targets that are not roadmap nodes are left to RRT*
+            std::unordered_map<Vertex, Vertex>::const_iterator roadmapVertex = roadmapVertices_.find(targetVertices[i]);
 
-            planner->setup();
+            if(roadmapVertex == roadmapVertices_.end())
+                continue;
 
-            ompl::base::PlannerStatus solved = planner->solve(ompl::magic::RRT_PLAN_MAX_TIME);
+            std::shared_ptr<ompl::geometric::PathGeometric> path(new ompl::geometric::PathGeometric(si_));
 
-            if(solved)
+            if(pathProvider_(currentBeliefStates_[i], stateProperty_[targetVertices[i]], roadmapVertex->second, *path))
             {
-                const ompl::base::PathPtr &path = pdef->getSolutionPath();
+                modePaths[i] = path;
+
+                Visualizer::addOpenLoopRRTPath(*path);
+            }
+        }
+    }
+
+    // Each mode gets its own planner and problem definition, so the runs go on a thread pool. Every run stops at
+    // its own RRT_PLAN_MAX_TIME or when the planning share of the round is used up, whichever comes first.
+
+    FIRMUtils::parallelFor(numModes, [&](unsigned int i)
+    {
+        //Generate a path for the mode/target pair
+        if(!isModeValid[i] || modePaths[i])
+            return;
 
-                ompl::geometric::PathGeometric gpath = static_cast<ompl::geometric::PathGeometric&>(*path);
+        ompl::base::PlannerPtr planner(new ompl::geometric::RRTstar(si_));
 
-                rrtPaths.push_back(gpath);
+        ompl::base::ProblemDefinitionPtr pdef(new ompl::base::ProblemDefinition(si_));
 
-                Visualizer::addOpenLoopRRTPath(gpath);
+        pdef->setStartAndGoalStates(currentBeliefStates_[i], stateProperty_[targetVertices[i]], ompl::magic::RRT_FINAL_PROXIMITY_THRESHOLD);
 
-                //boost::this_thread::sleep(boost::posix_time::milliseconds(50));
+        planner->as<ompl::geometric::RRT>()->setRange(1.0);
 
-                std::vector<ompl::control::Control*> olc;
+        planner->setProblemDefinition(pdef);
 
-                si_->getMotionModel()->generateOpenLoopControlsForPath(gpath, olc);
+        planner->setup();
 
-                openLoopPolicies.push_back(olc);
+        ompl::base::PlannerStatus solved = planner->solve(ompl::base::plannerOrTerminationCondition(budgetPtc,
+                                                            ompl::base::timedPlannerTerminationCondition(ompl::magic::RRT_PLAN_MAX_TIME)));
 
-            }
+        if(solved)
+        {
+            modePaths[i] = pdef->getSolutionPath();
 
-            planner->clear();
+            // show each path as soon as its planner is done
+            Visualizer::addOpenLoopRRTPath(static_cast<ompl::geometric::PathGeometric&>(*modePaths[i]));
         }
+
+        planner->clear();
+    });
+
+    // collect the solutions in mode order
+    for(unsigned int i = 0; i < numModes; i++)
+    {
+        if(!modePaths[i])
+            continue;
+
+        ompl::geometric::PathGeometric gpath = static_cast<ompl::geometric::PathGeometric&>(*modePaths[i]);
+
+        rrtPaths.push_back(gpath);
+
+        std::vector<ompl::control::Control*> olc;
+
+        si_->getMotionModel()->generateOpenLoopControlsForPath(gpath, olc);
+
+        openLoopPolicies.push_back(olc);
+
+        policyModes.push_back(i);
     }
 
     // Now that you have the open loop controls, need to execute them on all modes to see which is best
@@ -276,27 +440,50 @@ void NBM3P::generatePolicy(std::vector<ompl::control::Control*> &policy)
 
     Visualizer::doSaveVideo(false);
 
-    for(unsigned int i = 0; i < openLoopPolicies.size(); i++)
+    const unsigned int numPolicies = openLoopPolicies.size();
+
+    auto end_time_planning = std::chrono::high_resolution_clock::now();
+
+    // every policy/mode pair is simulated on its own copy of the modes, so all of them can run at once
+    std::vector<double> policyModeCosts(numPolicies*numModes, 0.0);
+
+    // pairs are handed out in order, so policies finish one after the other and a spent budget only cuts the last ones
+    std::vector<char> isEvaluated(numPolicies*numModes, 0);
+
+    FIRMUtils::parallelFor(numPolicies*numModes, [&](unsigned int k)
     {
-        ompl::base::Cost pGain(0);
+        if(isOverBudget())
+            return;
 
-        pGain = ompl::base::Cost(0);
+        const unsigned int i = k / numModes;
+        const unsigned int j = k % numModes;
 
-        for(unsigned int j = 0; j < currentBeliefStates_.size(); j++)
-        {
+        OMPL_INFORM("NBM3P: Evaluating Policy Number #%u  on Mode Number #%u",i,j);
 
-            OMPL_INFORM("NBM3P: Evaluating Policy Number #%u  on Mode Number #%u",i,j);
+        policyModeCosts[k] = executeOpenLoopPolicyOnMode(openLoopPolicies[i],currentBeliefStates_[j]).value();
 
-            ompl::base::Cost c = executeOpenLoopPolicyOnMode(openLoopPolicies[i],currentBeliefStates_[j]);
+        isEvaluated[k] = 1;
+    });
 
-            //pGain.v += c.v;
+    unsigned int numEvaluatedPolicies = 0;
 
-            pGain = ompl::base::Cost(pGain.value() + c.value());
+    for(unsigned int i = 0; i < numPolicies; i++)
+    {
+        // only a policy that was simulated on every mode can be compared with the others
+        if(std::find(isEvaluated.begin() + i*numModes, isEvaluated.begin() + (i+1)*numModes, 0) != isEvaluated.begin() + (i+1)*numModes)
+            continue;
+
+        numEvaluatedPolicies++;
+
+        ompl::base::Cost pGain(0);
 
+        for(unsigned int j = 0; j < numModes; j++)
+        {
+            pGain = ompl::base::Cost(pGain.value() + policyModeCosts[i*numModes + j]);
         }
 
         //pGain.v = weights_[i]*pGain.v;
-        pGain = ompl::base::Cost(weights_[i]*pGain.value());
+        pGain = ompl::base::Cost(weights_[policyModes[i]]*pGain.value());
 
         OMPL_INFORM("NBM3P: Weighted Information Gain for Policy #%u = %f",i,pGain.value());
 
@@ -310,7 +497,7 @@ void NBM3P::generatePolicy(std::vector<ompl::control::Control*> &policy)
         }
     }
 
-    OMPL_INFORM("NBM3P: Max gain policy index = %u", maxGainPolicyIndx);
+    OMPL_INFORM("NBM3P: Max gain policy index = %d", maxGainPolicyIndx);
 
     //std::cin.get();
 
@@ -323,101 +510,150 @@ void NBM3P::generatePolicy(std::vector<ompl::control::Control*> &policy)
 
         policy = openLoopPolicies[maxGainPolicyIndx];
 
+        // the old policy is replaced, hand its controls back
+        si_->getMotionModel()->freeControls(previousPolicy_);
+
         previousPolicy_ = policy;
 
+        previousPolicyStep_ = 0;
+
         Visualizer::addOpenLoopRRTPath(rrtPaths[maxGainPolicyIndx]);
 
     }
     else
     {
+        // resume the previous policy where its execution stopped, the controls already applied are dropped
+        std::vector<ompl::control::Control*> executed(previousPolicy_.begin(), previousPolicy_.begin() + previousPolicyStep_);
+
+        previousPolicy_.erase(previousPolicy_.begin(), previousPolicy_.begin() + previousPolicyStep_);
+
+        si_->getMotionModel()->freeControls(executed);
+
+        // once it has run out the robot holds still
+        if(previousPolicy_.empty())
+            previousPolicy_.push_back(si_->getMotionModel()->getZeroControl());
+
+        previousPolicyStep_ = 0;
+
         policy = previousPolicy_;
     }
 
+    // release the candidate policies that were not picked
+    for(unsigned int i = 0; i < openLoopPolicies.size(); i++)
+    {
+        if((int)i != maxGainPolicyIndx)
+            si_->getMotionModel()->freeControls(openLoopPolicies[i]);
+    }
+
     auto end_time_policygen = std::chrono::high_resolution_clock::now();
 
     std::cout << "Time to evaluate policy: "<<std::chrono::duration_cast<std::chrono::milliseconds>(end_time_policygen - start_time_policygen).count() << " milli seconds."<<std::endl;
 
+    if(isAnytime)
+    {
+        OMPL_INFORM("NBM3P: Round used %.3f of %.3f seconds (planning %.3f, evaluation %.3f), %u of %u paths planned, %u of %u policies evaluated%s",
+                    std::chrono::duration<double>(end_time_policygen - start_time_policygen).count(), roundBudget_,
+                    std::chrono::duration<double>(end_time_planning - start_time_policygen).count(),
+                    std::chrono::duration<double>(end_time_policygen - end_time_planning).count(),
+                    numPolicies, numModes, numEvaluatedPolicies, numPolicies,
+                    maxGainPolicyIndx < 0 ? ", reusing the previous policy" : "");
+    }
+
     //std::cin.get();
 
     si_->showRobotVisualization(true);
 
 }
 
-ompl::base::Cost NBM3P::executeOpenLoopPolicyOnMode(std::vector<ompl::control::Control*> controls,
-                                                                const ompl::base::State* state)
+ompl::base::Cost NBM3P::executeOpenLoopPolicyOnMode(const std::vector<ompl::control::Control*> &controls,
+                                                                const ompl::base::State* state) const
+{
+    ModeSimulation simulation(*this);
+
+    return simulation.run(controls, state);
+}
+
+NBM3P::ModeSimulation::ModeSimulation(const NBM3P &planner) :
+    planner_(planner),
+    si_(planner.si_),
+    scope_(planner.si_),
+    filter_(planner.si_),
+    weights_(planner.weights_),
+    timeSinceDivergence_(planner.timeSinceDivergence_)
 {
+    trueState_ = scope_.allocState();
+
+    scratchState_ = scope_.allocState();
 
-    double I1 = 0;
-    //get weighted sum of trace of covariance
-    for(int i = 0; i < currentBeliefStates_.size(); i++)
+    beliefStates_.reserve(planner.currentBeliefStates_.size());
+
+    for(unsigned int i = 0; i < planner.currentBeliefStates_.size(); i++)
     {
-         I1 +=   weights_[i]/arma::trace(currentBeliefStates_[i]->as<SE2BeliefSpace::StateType>()->getCovariance());
+        beliefStates_.push_back(si_->cloneState(planner.currentBeliefStates_[i]));
     }
 
-    std::vector<float> weightsCopy = weights_;
-    std::vector<ompl::base::State*> currentBeliefStatesCopy;
+    timeSinceDivergence_.resize(beliefStates_.size(), 0.0);
+}
 
-    for(int i=0; i < currentBeliefStates_.size(); i++)
+NBM3P::ModeSimulation::~ModeSimulation()
+{
+    for(unsigned int i = 0; i < beliefStates_.size(); i++)
     {
-        currentBeliefStatesCopy.push_back(si_->cloneState(currentBeliefStates_[i]));
+        si_->freeState(beliefStates_[i]);
     }
+}
 
-    ompl::base::State *currentTrueState = si_->allocState();
-    si_->getTrueState(currentTrueState);
+ompl::base::Cost NBM3P::ModeSimulation::run(const std::vector<ompl::control::Control*> &controls, const ompl::base::State *trueState)
+{
+    si_->copyState(trueState_, trueState);
 
-    si_->setTrueState(state);
+    const unsigned int numModesBefore = beliefStates_.size();
 
     ompl::base::Cost olpInfGain(0);
 
     for(int i=0; i < controls.size() ; i++)
     {
-        si_->applyControl(controls[i],false);
-
-        propagateBeliefs(controls[i], true);
+        propagate(controls[i]);
 
-        if(!si_->checkTrueStateValidity()/*!areCurrentBeliefsValid()*/)
+        if(!si_->isValid(trueState_))
         {
-            //olpInfGain.v -= ompl::magic::COLISSION_FAILURE_COST/(i+1);
             olpInfGain = ompl::base::Cost(olpInfGain.value() - ompl::magic::COLISSION_FAILURE_COST/(i+1));
             OMPL_INFORM("NBM3P: Collided in sim");
-            //std::cin.get();
             break;
         }
 
     }
 
-    double I2 = 0;
-
-    //get weighted sum of trace of covariance
-    for(int i = 0; i < currentBeliefStates_.size(); i++)
-    {
-         I2 +=   weights_[i]/arma::trace(currentBeliefStates_[i]->as<SE2BeliefSpace::StateType>()->getCovariance());
-    }
-
-    double changeInNumberOfModes = (double)(currentBeliefStatesCopy.size() - currentBeliefStates_.size());
+    double changeInNumberOfModes = (double)numModesBefore - (double)beliefStates_.size();
 
     OMPL_INFORM("The discrete change in number of modes: %f",  changeInNumberOfModes);
 
-    //olpInfGain.v +=  changeInNumberOfModes;
     olpInfGain = ompl::base::Cost(olpInfGain.value() + changeInNumberOfModes);
 
-    // reset old weight values
-    weights_ = weightsCopy;
+    return olpInfGain;
+}
 
-    // free unneeded states
-    for(int i = 0; i < currentBeliefStates_.size(); i++)
-    {
-         si_->freeState(currentBeliefStates_[i]);
-    }
+void NBM3P::ModeSimulation::propagate(const ompl::control::Control *control)
+{
+    // move the simulated robot without noise, same as applyControl(control, false) on the true state
+    si_->getMotionModel()->Evolve(trueState_, control, si_->getMotionModel()->getZeroNoise(), trueState_);
 
-    // set back to old states
-    currentBeliefStates_ = currentBeliefStatesCopy;
+    static thread_local arma::colvec obs;
 
-    // set back true state
-    si_->setTrueState(currentTrueState);
+    si_->getObservationModel()->getObservation(trueState_, true, obs);
 
-    return olpInfGain;
+    LinearSystem dummy;
+
+    for(unsigned int i = 0; i < beliefStates_.size(); i++)
+    {
+        filter_.Evolve(beliefStates_[i], control, obs, dummy, dummy, scratchState_);
 
+        si_->copyState(beliefStates_[i], scratchState_);
+    }
+
+    planner_.updateWeights(obs, beliefStates_, weights_, timeSinceDivergence_);
+
+    planner_.removeDuplicateModes(beliefStates_, weights_, timeSinceDivergence_);
 }
 
 
@@ -430,21 +666,19 @@ void NBM3P::propagateBeliefs(const ompl::control::Control *control, bool isSimul
 
     arma::colvec obs = policyExecutionSI_->getObservation();
 
-    for(unsigned int i = 0; i < currentBeliefStates_.size(); i++)
-    {
-        ompl::base::State *kfEstimate = si_->allocState();
-        ompl::base::State *kfEstimateUpdated = si_->allocState();
-
-        si_->copyState(kfEstimate, currentBeliefStates_[i]);
+    // keep track of how far the previous policy got, generatePolicy resumes it from there if no new policy is found
+    if(previousPolicyStep_ < previousPolicy_.size() && control == previousPolicy_[previousPolicyStep_])
+        previousPolicyStep_++;
 
-        kf.Evolve(kfEstimate, control, obs, dummy, dummy, kfEstimateUpdated);
-
-        si_->copyState(currentBeliefStates_[i], kfEstimateUpdated);
+    firm::AllocationScope scope(si_);
 
-        si_->freeState(kfEstimate);
+    ompl::base::State *kfEstimateUpdated = scope.allocState();
 
-        si_->freeState(kfEstimateUpdated);
+    for(unsigned int i = 0; i < currentBeliefStates_.size(); i++)
+    {
+        kf.Evolve(currentBeliefStates_[i], control, obs, dummy, dummy, kfEstimateUpdated);
 
+        si_->copyState(currentBeliefStates_[i], kfEstimateUpdated);
     }
 
     /*
@@ -494,33 +728,54 @@ bool NBM3P::areSimilarWeights()
 
 void NBM3P::updateWeights(const arma::colvec trueObservation)
 {
+    this->updateWeights(trueObservation, currentBeliefStates_, weights_, timeSinceDivergence_);
+}
+
+void NBM3P::updateWeights(const arma::colvec &trueObservation, std::vector<ompl::base::State*> &beliefStates,
+                          std::vector<float> &weights, std::vector<double> &timeSinceDivergence) const
+{
+    // The innovation covariance is diagonal with the same range and bearing variance for every landmark, so the
+    // exponent of the Gaussian reduces to a sum of squared normalized innovations.
+    const double invRangeVariance = 1.0 / (ompl::magic::SIGMA_RANGE*ompl::magic::SIGMA_RANGE);
+    const double invBearingVariance = 1.0 / (ompl::magic::SIGMA_THETA*ompl::magic::SIGMA_THETA);
+
+    // index of the landmark ids predicted at a mode, reused by all modes
+    LandmarkIndex predictedLandmarks;
+
+    // the observations predicted at every mode, in one batch so the observation model can share work between nearby modes
+    static thread_local std::vector<const ompl::base::State*> modes;
 
-    arma::colvec sigma(2);
+    static thread_local std::vector<arma::colvec> predictedObservations;
 
-    sigma(0) = ompl::magic::SIGMA_RANGE;
-    sigma(1) = ompl::magic::SIGMA_THETA;
+    modes.assign(beliefStates.begin(), beliefStates.end());
 
-    arma::colvec variance = arma::pow(sigma,2);
+    si_->getObservationModel()->getObservations(modes, false, predictedObservations);
+
+    // reused by all modes
+    arma::colvec innov;
 
     float totalWeight = 0.0;
 
-    for(unsigned int i = 0; i < currentBeliefStates_.size(); i++)
+    for(unsigned int i = 0; i < beliefStates.size(); i++)
     {
 
         double weightFactor= 1.0;
 
-        arma::colvec innov = this->computeInnovation(i,trueObservation,weightFactor);
+        const unsigned int numIntersection = this->matchObservation(predictedObservations[i], trueObservation, predictedLandmarks, innov, timeSinceDivergence[i], weightFactor);
 
         float w;
 
         // robot and mode see something in common
-        if(innov.n_rows != 0)
+        if(numIntersection != 0)
         {
-            arma::mat covariance = arma::diagmat(arma::repmat(arma::diagmat(variance), innov.n_rows/2, innov.n_rows/2)) ;
+            double normalizedInnovation = 0.0;
 
-            arma::mat t = -0.5*trans(innov)*covariance.i()*innov;
+            for(unsigned int k = 0; k < numIntersection; k++)
+            {
+                normalizedInnovation += innov(2*k)*innov(2*k)*invRangeVariance + innov(2*k+1)*innov(2*k+1)*invBearingVariance;
+            }
 
-            w = std::exp(t(0,0)) * weightFactor;
+            w = std::exp(-0.5*normalizedInnovation) * weightFactor;
 
         }
         // if there is no innov it means there is no common observation
@@ -539,39 +794,39 @@ void NBM3P::updateWeights(const arma::colvec trueObservation)
             }
         }
 
-        weights_[i]  = weights_[i]*w;
+        weights[i]  = weights[i]*w;
 
-        totalWeight += weights_[i];
+        totalWeight += weights[i];
 
     }
 
     // if totalWeight becomes 0, reset to uniform distribution
     if(totalWeight==0)
     {
-        for(unsigned int i=0; i< weights_.size(); i++)
+        for(unsigned int i=0; i< weights.size(); i++)
         {
-            weights_[i] = 1.0/weights_.size();
+            weights[i] = 1.0/weights.size();
         }
         return;
     }
     else
     {
-        normalizeWeights();
+        normalizeWeights(weights);
 
     }
 
     std::vector<int> beliefsToRemove;
 
-    for(unsigned int i = 0; i < weights_.size(); i++)
+    for(unsigned int i = 0; i < weights.size(); i++)
     {
         // if the weight of the mode is less than threshold, delete it
-        if(weights_[i]/totalWeight < ompl::magic::MODE_DELETION_THRESHOLD || weights_[i] == 0.0 )
+        if(weights[i]/totalWeight < ompl::magic::MODE_DELETION_THRESHOLD || weights[i] == 0.0 )
         {
             beliefsToRemove.push_back(i);
         }
     }
 
-    removeBeliefs(beliefsToRemove);
+    removeBeliefs(beliefsToRemove, beliefStates, weights, timeSinceDivergence);
 
 }
 
@@ -685,56 +940,50 @@ float NBM3P::computeWeightForMode(const int currentBeliefIndx,const arma::colvec
 
 arma::colvec NBM3P::computeInnovation(const int currentBeliefIndx,const arma::colvec trueObservation, double &weightFactor)
 {
-    const int singleObservationDim = 4;//CamAruco2DObservationModel::singleObservationDim;
+    return this->computeInnovation(currentBeliefStates_[currentBeliefIndx], trueObservation, timeSinceDivergence_[currentBeliefIndx], weightFactor);
+}
 
-    const int landmarkInfoDim = 2;//CamAruco2DObservationModel::landmarkInfoDim;
+arma::colvec NBM3P::computeInnovation(const ompl::base::State *mode, const arma::colvec &trueObservation, double &timeSinceDivergence, double &weightFactor) const
+{
+    LandmarkIndex predictedLandmarks;
 
-    // the true observation
-    arma::colvec Zg = trueObservation;
+    arma::colvec innov;
 
-    int landmarksActuallySeen = Zg.n_rows / singleObservationDim;
+    const unsigned int numIntersection = matchObservation(si_->getObservationModel()->getObservation(mode, false), trueObservation, predictedLandmarks,
+                                                          innov, timeSinceDivergence, weightFactor);
 
-    // the beliefs predicted observation
-    arma::colvec Zprd =  si_->getObservationModel()->getObservation(currentBeliefStates_[currentBeliefIndx], false);
+    innov.resize(numIntersection*CamAruco2DObservationModel::landmarkInfoDim);
 
-    int predictedLandmarksSeen = Zprd.n_rows / singleObservationDim ;
+    return innov;
+}
 
-    arma::colvec innov;
+void NBM3P::indexObservation(const arma::colvec &observation, LandmarkIndex &landmarks)
+{
+    const int singleObservationDim = CamAruco2DObservationModel::singleObservationDim;
 
-    int numIntersection=0;
+    const unsigned int numLandmarks = observation.n_rows / singleObservationDim;
 
-    //First we see if a landmark that is observed by robot is seen by mode:
-    //1. If yes, then we compute the innov
-    //2. If no, then we predict where the mode "would" see that particular landmark and then calculate the innov
-    for(int j = 0 ; j < landmarksActuallySeen ; j++)
-    {
-        // match ids
-        for(int k = 0 ; k < predictedLandmarksSeen ; k++)
-        {
-            if(Zprd(k*singleObservationDim) == Zg(j*singleObservationDim))
-            {
+    landmarks.clear();
 
-                arma::colvec innov_for_landmark(2);
+    landmarks.reserve(numLandmarks);
 
-                innov_for_landmark(0) = Zg(j*singleObservationDim + 1) - Zprd(k*singleObservationDim + 1) ;
-
-                double delta_theta = Zg(j*singleObservationDim + 2) - Zprd(k*singleObservationDim + 2) ;
-
-                FIRMUtils::normalizeAngleToPiRange(delta_theta);
-
-                assert(abs(delta_theta) <= 2*boost::math::constants::pi<double>()) ;
-
-                innov_for_landmark(1) =  delta_theta;
+    for(unsigned int j = 0; j < numLandmarks; j++)
+    {
+        // keep the first occurrence of an id, same as a front to back search
+        landmarks.insert(std::make_pair((int)observation(j*singleObservationDim), j));
+    }
+}
 
-                innov.insert_rows(numIntersection*landmarkInfoDim, innov_for_landmark);
+unsigned int NBM3P::matchObservation(const arma::colvec &predictedObservation, const arma::colvec &trueObservation, LandmarkIndex &predictedLandmarks,
+                                     arma::colvec &innov, double &timeSinceDivergence, double &weightFactor) const
+{
+    const int singleObservationDim = CamAruco2DObservationModel::singleObservationDim;
 
-                numIntersection++;
+    int landmarksActuallySeen = trueObservation.n_rows / singleObservationDim;
 
-                break;
-            }
-        }
+    int predictedLandmarksSeen = predictedObservation.n_rows / singleObservationDim ;
 
-    }
+    int numIntersection = matchLandmarks(predictedObservation, trueObservation, predictedLandmarks, innov);
 
     // there is a mismatch in what the robot sees and predicted
     if(numIntersection != landmarksActuallySeen || numIntersection != predictedLandmarksSeen )
@@ -743,55 +992,108 @@ arma::colvec NBM3P::computeInnovation(const int currentBeliefIndx,const arma::co
         //weightFactor = std::min(1.0 / abs(1 + landmarksActuallySeen - numIntersection) , 1.0 / abs(1 + predictedLandmarksSeen - numIntersection));
         float heuristicVal = std::max(abs(1 + landmarksActuallySeen - numIntersection) , abs(1 + predictedLandmarksSeen - numIntersection));
 
-        weightFactor = std::exp(-heuristicVal*timeSinceDivergence_[currentBeliefIndx]*1e-4);
+        weightFactor = std::exp(-heuristicVal*timeSinceDivergence*1e-4);
 
-        timeSinceDivergence_[currentBeliefIndx] = timeSinceDivergence_[currentBeliefIndx] + std::pow(si_->getMotionModel()->getTimestepSize(),1);
+        timeSinceDivergence = timeSinceDivergence + std::pow(si_->getMotionModel()->getTimestepSize(),1);
 
     }
     else
     {
-         //timeSinceDivergence_[currentBeliefIndx] = timeSinceDivergence_[currentBeliefIndx] - 1.0;
+        timeSinceDivergence = 0;
+    }
 
-         //if(timeSinceDivergence_[currentBeliefIndx] < 0)
-         //{
-            timeSinceDivergence_[currentBeliefIndx] = 0;
-         //}
+    return numIntersection;
+}
+
+unsigned int NBM3P::matchLandmarks(const arma::colvec &predictedObservation, const arma::colvec &trueObservation, LandmarkIndex &predictedLandmarks,
+                                   arma::colvec &innov)
+{
+    const int singleObservationDim = CamAruco2DObservationModel::singleObservationDim;
+
+    const int landmarkInfoDim = CamAruco2DObservationModel::landmarkInfoDim;
+
+    // the true observation
+    const arma::colvec &Zg = trueObservation;
+
+    int landmarksActuallySeen = Zg.n_rows / singleObservationDim;
+
+    // the beliefs predicted observation
+    const arma::colvec &Zprd = predictedObservation;
+
+    // every landmark the robot sees is matched at most once, even if the mode predicts its id several times
+    if((int)innov.n_rows < landmarksActuallySeen*landmarkInfoDim)
+        innov.set_size(landmarksActuallySeen*landmarkInfoDim);
+
+    indexObservation(Zprd, predictedLandmarks);
+
+    int numIntersection=0;
+
+    //We see which landmarks observed by the robot are also seen by the mode and compute the innov for those
+    for(int j = 0 ; j < landmarksActuallySeen ; j++)
+    {
+        LandmarkIndex::const_iterator match = predictedLandmarks.find((int)Zg(j*singleObservationDim));
+
+        if(match == predictedLandmarks.end())
+            continue;
+
+        const int k = match->second;
+
+        innov(numIntersection*landmarkInfoDim) = Zg(j*singleObservationDim + 1) - Zprd(k*singleObservationDim + 1) ;
+
+        double delta_theta = Zg(j*singleObservationDim + 2) - Zprd(k*singleObservationDim + 2) ;
+
+        FIRMUtils::normalizeAngleToPiRange(delta_theta);
+
+        innov(numIntersection*landmarkInfoDim + 1) =  delta_theta;
+
+        numIntersection++;
     }
 
+    assert(numIntersection <= landmarksActuallySeen);
 
-    return innov;
+    return numIntersection;
 }
 
 void NBM3P::removeBeliefs(const std::vector<int> Indxs)
 {
-    // Make a local copy
-    std::vector<ompl::base::State*> currentBeliefStatesCopy = currentBeliefStates_;
-    std::vector<float> weightsCopy = weights_;
-    std::vector<double>  timeSinceDivergenceCopy = timeSinceDivergence_;
+    this->removeBeliefs(Indxs, currentBeliefStates_, weights_, timeSinceDivergence_);
+}
 
-    weights_.clear();
-    currentBeliefStates_.clear();
-    timeSinceDivergence_.clear();
+void NBM3P::removeBeliefs(const std::vector<int> &Indxs, std::vector<ompl::base::State*> &beliefStates,
+                          std::vector<float> &weights, std::vector<double> &timeSinceDivergence) const
+{
+    std::vector<bool> toRemove(beliefStates.size(), false);
 
-    for(int i = 0 ; i < currentBeliefStatesCopy.size(); i++)
+    for(unsigned int i = 0; i < Indxs.size(); i++)
     {
-        // check if this index is in the list marked to be deleted. If not, then we keep it
-        std::vector<int>::const_iterator it = std::find(Indxs.begin(), Indxs.end(), i) ;
+        if(Indxs[i] >= 0 && Indxs[i] < (int)beliefStates.size())
+            toRemove[Indxs[i]] = true;
+    }
 
-        if(it == Indxs.end())
-        {
-            currentBeliefStates_.push_back(currentBeliefStatesCopy[i]);
-            weights_.push_back(weightsCopy[i]);
-            timeSinceDivergence_.push_back(timeSinceDivergenceCopy[i]);
-        }
+    // single stable pass, the kept modes slide down over the removed ones
+    unsigned int kept = 0;
+
+    for(unsigned int i = 0 ; i < beliefStates.size(); i++)
+    {
         // if it was marked to be deleted, then we free memory for that state
-        else
+        if(toRemove[i])
         {
-            si_->freeState(currentBeliefStatesCopy[i]);
+            si_->freeState(beliefStates[i]);
+            continue;
         }
+
+        beliefStates[kept] = beliefStates[i];
+        weights[kept] = weights[i];
+        timeSinceDivergence[kept] = timeSinceDivergence[i];
+
+        kept++;
     }
 
-    normalizeWeights();
+    beliefStates.resize(kept);
+    weights.resize(kept);
+    timeSinceDivergence.resize(kept);
+
+    normalizeWeights(weights);
 
 }
 
@@ -816,10 +1118,15 @@ bool NBM3P::isConverged()
     if(currentBeliefStates_.size()==1)
         return true;
 
+    // released on every return, including the early one on a collision
+    firm::AllocationScope scope(si_);
+
+    ompl::base::State* tempState = scope.allocState();
+
     for(int i =0 ; i< currentBeliefStates_.size(); i++)
     {
 
-        ompl::base::State* tempState = si_->cloneState(currentBeliefStates_[i]);
+        si_->copyState(tempState, currentBeliefStates_[i]);
 
         for(int j = currentStep; j < currentStep + clearanceHorizon ; j++)
         {
@@ -835,8 +1142,6 @@ bool NBM3P::isConverged()
 
         }
 
-        si_->freeState(tempState);
-
         /*
         double clearance  = si_->getStateValidityChecker()->clearance(currentBeliefStates_[i]) ;
 
@@ -872,44 +1177,385 @@ bool NBM3P::isConverged()
 
 void NBM3P::removeDuplicateModes()
 {
+    this->removeDuplicateModes(currentBeliefStates_, weights_, timeSinceDivergence_);
+}
+
+void NBM3P::removeDuplicateModes(std::vector<ompl::base::State*> &beliefStates, std::vector<float> &weights, std::vector<double> &timeSinceDivergence) const
+{
+    const double positionTolerance = ompl::magic::DUPLICATE_MODE_POSITION_TOLERANCE;
+
+    const double yawTolerance = FIRMUtils::degree2Radian(ompl::magic::DUPLICATE_MODE_YAW_TOLERANCE);
+
+    // Modes are bucketed in cells as large as the tolerances, so a duplicate of a mode can only be in one of the
+    // 27 cells around it. Each cell holds the surviving modes seen so far.
+    std::unordered_map<long long, std::vector<int> > grid;
+
     std::vector<int> toDelete;
 
-    for(int i = 0; i < currentBeliefStates_.size(); i++)
+    for(int i = 0; i < beliefStates.size(); i++)
     {
-        for(int j = i+1; j < currentBeliefStates_.size(); j++ )
+        const SE2BeliefSpace::StateType *xi = beliefStates[i]->as<SE2BeliefSpace::StateType>();
+
+        const long long cx = std::floor(xi->getX() / positionTolerance);
+        const long long cy = std::floor(xi->getY() / positionTolerance);
+        const long long cyaw = std::floor(xi->getYaw() / yawTolerance);
+
+        // the earliest surviving mode that i duplicates, if any
+        int duplicateOf = -1;
+        long long duplicateCell = 0;
+
+        for(long long dx = -1; dx <= 1; dx++)
         {
-            if(i!=j)
+            for(long long dy = -1; dy <= 1; dy++)
             {
-                arma::colvec xi = currentBeliefStates_[i]->as<SE2BeliefSpace::StateType>()->getArmaData();
-                arma::colvec xj = currentBeliefStates_[j]->as<SE2BeliefSpace::StateType>()->getArmaData();
+                for(long long dyaw = -1; dyaw <= 1; dyaw++)
+                {
+                    const long long key = modeCellKey(cx+dx, cy+dy, cyaw+dyaw);
 
-                double xd = xi(0) - xj(0);
-                double yd = xi(1) - xj(1);
-                double thetad = xi(2) - xj(2);
+                    std::unordered_map<long long, std::vector<int> >::const_iterator cell = grid.find(key);
 
-                if(std::abs(xd) < 0.01 && std::abs(yd) < 0.01 &&  std::abs(thetad) < FIRMUtils::degree2Radian(1.0) )
-                {
+                    if(cell == grid.end())
+                        continue;
 
-                    if(weights_[i] >= weights_[j] )
+                    foreach(int j, cell->second)
                     {
-                        toDelete.push_back(j);
-                        weights_[i] = weights_[i] + weights_[j]; // transfer the weight to the more likely mode
+                        const SE2BeliefSpace::StateType *xj = beliefStates[j]->as<SE2BeliefSpace::StateType>();
+
+                        if(std::abs(xi->getX() - xj->getX()) < positionTolerance && std::abs(xi->getY() - xj->getY()) < positionTolerance
+                            && std::abs(xi->getYaw() - xj->getYaw()) < yawTolerance && (duplicateOf < 0 || j < duplicateOf))
+                        {
+                            duplicateOf = j;
+                            duplicateCell = key;
+                        }
                     }
-                    else
-                    {
-                        toDelete.push_back(i);
-                        weights_[j] = weights_[i] + weights_[j]; // transfer the weight to the more likely mode
+                }
+            }
+        }
 
-                    }
+        const long long ownCell = modeCellKey(cx, cy, cyaw);
+
+        if(duplicateOf < 0)
+        {
+            grid[ownCell].push_back(i);
+        }
+        else if(weights[duplicateOf] >= weights[i])
+        {
+            toDelete.push_back(i);
+            weights[duplicateOf] = weights[duplicateOf] + weights[i]; // transfer the weight to the more likely mode
+        }
+        else
+        {
+            toDelete.push_back(duplicateOf);
+            weights[i] = weights[i] + weights[duplicateOf]; // transfer the weight to the more likely mode
+
+            // i takes the place of the mode it absorbed
+            std::vector<int> &cell = grid[duplicateCell];
+            cell.erase(std::find(cell.begin(), cell.end(), duplicateOf));
+
+            grid[ownCell].push_back(i);
+        }
+    }
+
+    this->removeBeliefs(toDelete, beliefStates, weights, timeSinceDivergence);
+
+}
+
+namespace
+{
+    /** \brief A Gaussian mode, yaw is kept continuous with the mode it is merged with */
+    struct MixtureComponent
+    {
+        arma::colvec mean;
+
+        arma::mat cov;
+
+        double weight;
+
+        double logDetCov;
+    };
+
+    /** \brief Moment preserving merge of two components */
+    MixtureComponent mergeComponents(const MixtureComponent &a, const MixtureComponent &b)
+    {
+        MixtureComponent m;
+
+        m.weight = a.weight + b.weight;
+
+        const double wa = m.weight > 0 ? a.weight / m.weight : 0.5;
+        const double wb = 1.0 - wa;
+
+        // the yaw of b is taken relative to a so the two do not average across the +-pi seam
+        arma::colvec d = b.mean - a.mean;
+        FIRMUtils::normalizeAngleToPiRange(d[2]);
+
+        m.mean = a.mean + wb*d;
+        FIRMUtils::normalizeAngleToPiRange(m.mean[2]);
+
+        m.cov = wa*a.cov + wb*b.cov + wa*wb*d*d.t();
+
+        double sign = 0;
+        arma::log_det(m.logDetCov, sign, m.cov);
+
+        return m;
+    }
+
+    /** \brief Upper bound on the KL divergence caused by merging a and b (Runnalls 2007) */
+    double mergeCost(const MixtureComponent &a, const MixtureComponent &b)
+    {
+        const MixtureComponent m = mergeComponents(a, b);
+
+        return 0.5*(m.weight*m.logDetCov - a.weight*a.logDetCov - b.weight*b.logDetCov);
+    }
+}
+
+void NBM3P::reduceModes(std::vector<ompl::base::State*> &beliefStates, std::vector<float> &weights,
+                        std::vector<double> &timeSinceDivergence, const unsigned int maxModes) const
+{
+    const unsigned int numModes = beliefStates.size();
+
+    if(maxModes == 0 || numModes <= maxModes)
+        return;
+
+    OMPL_INFORM("NBM3P: Merging %u modes down to %u", numModes, maxModes);
+
+    std::vector<MixtureComponent> components(numModes);
+
+    for(unsigned int i = 0; i < numModes; i++)
+    {
+        const SE2BeliefSpace::StateType *x = beliefStates[i]->as<SE2BeliefSpace::StateType>();
+
+        components[i].mean = x->getArmaData();
+        components[i].cov = x->getCovariance();
+        components[i].weight = weights[i];
+
+        double sign = 0;
+        arma::log_det(components[i].logDetCov, sign, components[i].cov);
+    }
+
+    // Greedy Runnalls reduction: repeatedly merge the cheapest candidate pair. Only the nearest modes of each mode are
+    // candidates, a merged mode gets fresh candidates and the entries of the modes it replaced go stale.
+    struct Candidate
+    {
+        double cost;
+        unsigned int i, j;
+        unsigned int versionI, versionJ;
+
+        bool operator>(const Candidate &other) const
+        {
+            return cost > other.cost;
+        }
+    };
+
+    std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate> > candidates;
+
+    std::vector<bool> alive(numModes, true);
+
+    std::vector<unsigned int> version(numModes, 0);
+
+    unsigned int numAlive = numModes;
+
+    // The nearest modes are looked up in the 27 (x, y, yaw) cells around a mode, like duplicates are. The cells are
+    // sized so a cell holds about MODE_MERGE_CANDIDATES modes on average and grow when no pair is left to merge.
+    double minX = std::numeric_limits<double>::max(), minY = minX, maxX = -minX, maxY = -minX;
+
+    for(unsigned int i = 0; i < numModes; i++)
+    {
+        minX = std::min(minX, components[i].mean[0]);
+        minY = std::min(minY, components[i].mean[1]);
+        maxX = std::max(maxX, components[i].mean[0]);
+        maxY = std::max(maxY, components[i].mean[1]);
+    }
+
+    const double extent = std::max(maxX - minX, maxY - minY);
+
+    const long long numYawCells = ompl::magic::MODE_MERGE_YAW_CELLS;
+
+    const double yawCell = 2*boost::math::constants::pi<double>() / numYawCells;
+
+    double positionCell = std::max(ompl::magic::DUPLICATE_MODE_POSITION_TOLERANCE,
+                                   std::sqrt((maxX - minX)*(maxY - minY)*numYawCells*ompl::magic::MODE_MERGE_CANDIDATES / numModes));
+
+    std::unordered_map<long long, std::vector<unsigned int> > grid;
+
+    std::vector<long long> cellOf(numModes);
+
+    auto cellCoordinates = [&](const unsigned int i, long long &cx, long long &cy, long long &cyaw)
+    {
+        cx = std::floor(components[i].mean[0] / positionCell);
+        cy = std::floor(components[i].mean[1] / positionCell);
+        cyaw = ((long long)std::floor(components[i].mean[2] / yawCell) % numYawCells + numYawCells) % numYawCells;
+    };
 
+    auto insertMode = [&](const unsigned int i)
+    {
+        long long cx, cy, cyaw;
+        cellCoordinates(i, cx, cy, cyaw);
+
+        cellOf[i] = modeCellKey(cx, cy, cyaw);
+
+        grid[cellOf[i]].push_back(i);
+    };
+
+    auto eraseMode = [&](const unsigned int i)
+    {
+        std::vector<unsigned int> &cell = grid[cellOf[i]];
+        cell.erase(std::find(cell.begin(), cell.end(), i));
+    };
+
+    auto rebuildGrid = [&]()
+    {
+        grid.clear();
+
+        for(unsigned int i = 0; i < numModes; i++)
+        {
+            if(alive[i])
+                insertMode(i);
+        }
+    };
+
+    // pairs whose merged mean is invalid, e.g. two hypotheses on either side of a wall, are not proposed again
+    std::unordered_set<long long> rejected;
+
+    auto pairKey = [](const unsigned int i, const unsigned int j)
+    {
+        return ((long long)std::min(i, j) << 32) | (long long)std::max(i, j);
+    };
+
+    std::vector<std::pair<double, unsigned int> > nearest;
+
+    auto addCandidates = [&](const unsigned int i)
+    {
+        nearest.clear();
+
+        long long cx, cy, cyaw;
+        cellCoordinates(i, cx, cy, cyaw);
+
+        for(long long dx = -1; dx <= 1; dx++)
+        {
+            for(long long dy = -1; dy <= 1; dy++)
+            {
+                for(long long dyaw = -1; dyaw <= 1; dyaw++)
+                {
+                    // yaw cells wrap around at +-pi
+                    const long long key = modeCellKey(cx+dx, cy+dy, ((cyaw+dyaw) % numYawCells + numYawCells) % numYawCells);
+
+                    std::unordered_map<long long, std::vector<unsigned int> >::const_iterator cell = grid.find(key);
+
+                    if(cell == grid.end())
+                        continue;
+
+                    foreach(unsigned int j, cell->second)
+                    {
+                        if(j != i && rejected.find(pairKey(i, j)) == rejected.end())
+                            nearest.push_back(std::make_pair(si_->distance(beliefStates[i], beliefStates[j]), j));
+                    }
                 }
             }
+        }
+
+        const unsigned int k = std::min<std::size_t>(ompl::magic::MODE_MERGE_CANDIDATES, nearest.size());
+
+        std::partial_sort(nearest.begin(), nearest.begin() + k, nearest.end());
+
+        for(unsigned int n = 0; n < k; n++)
+        {
+            const unsigned int j = nearest[n].second;
+
+            Candidate c = {mergeCost(components[i], components[j]), i, j, version[i], version[j]};
+
+            candidates.push(c);
+        }
+    };
+
+    rebuildGrid();
+
+    firm::AllocationScope scope(si_);
+
+    ompl::base::State *mergedState = scope.allocState();
+
+    std::vector<int> toDelete;
+
+    while(numAlive > maxModes)
+    {
+        // stale entries can run the queue dry, refill it from the surviving modes
+        if(candidates.empty())
+        {
+            for(unsigned int i = 0; i < numModes; i++)
+            {
+                if(alive[i])
+                    addCandidates(i);
+            }
+        }
 
+        // no neighborhood has a pair left, look farther
+        if(candidates.empty())
+        {
+            if(positionCell > extent)
+            {
+                OMPL_WARN("NBM3P: No more modes can be merged without leaving free space, keeping %u modes", numAlive);
+                break;
+            }
+
+            positionCell *= 2;
+
+            rebuildGrid();
+
+            continue;
         }
+
+        const Candidate c = candidates.top();
+
+        candidates.pop();
+
+        if(!alive[c.i] || !alive[c.j] || version[c.i] != c.versionI || version[c.j] != c.versionJ)
+            continue;
+
+        // the heavier mode absorbs the lighter one, so the surviving state keeps its divergence timer
+        const unsigned int keep = components[c.i].weight >= components[c.j].weight ? c.i : c.j;
+        const unsigned int drop = keep == c.i ? c.j : c.i;
+
+        const MixtureComponent merged = mergeComponents(components[keep], components[drop]);
+
+        mergedState->as<SE2BeliefSpace::StateType>()->setXYYaw(merged.mean[0], merged.mean[1], merged.mean[2]);
+
+        if(!si_->isValid(mergedState))
+        {
+            rejected.insert(pairKey(c.i, c.j));
+            continue;
+        }
+
+        eraseMode(keep);
+        eraseMode(drop);
+
+        components[keep] = merged;
+
+        alive[drop] = false;
+        version[keep]++;
+        numAlive--;
+
+        toDelete.push_back(drop);
+
+        SE2BeliefSpace::StateType *x = beliefStates[keep]->as<SE2BeliefSpace::StateType>();
+
+        x->setXYYaw(components[keep].mean[0], components[keep].mean[1], components[keep].mean[2]);
+        x->setCovariance(components[keep].cov);
+
+        weights[keep] = components[keep].weight;
+
+        insertMode(keep);
+
+        addCandidates(keep);
     }
 
-    this->removeBeliefs(toDelete);
+    this->removeBeliefs(toDelete, beliefStates, weights, timeSinceDivergence);
+}
+
+long long NBM3P::modeCellKey(const long long cellX, const long long cellY, const long long cellYaw)
+{
+    // 21 bits per axis is plenty for the workspace at centimeter resolution
+    const long long mask = (1LL << 21) - 1;
 
+    return ((cellX & mask) << 42) | ((cellY & mask) << 21) | (cellYaw & mask);
 }
 
 
@@ -941,12 +1587,17 @@ void NBM3P::getStateWithMaxWeight(ompl::base::State *state, float &weight)
 
 void NBM3P::normalizeWeights()
 {
-    float totalWeight = std::accumulate(weights_.begin(), weights_.end(), 0.0);
+    normalizeWeights(weights_);
+}
+
+void NBM3P::normalizeWeights(std::vector<float> &weights)
+{
+    float totalWeight = std::accumulate(weights.begin(), weights.end(), 0.0);
 
     // Normalize the weights
-     for(unsigned int i = 0; i < weights_.size(); i++)
+     for(unsigned int i = 0; i < weights.size(); i++)
     {
-        weights_[i] =  weights_[i]/totalWeight;
+        weights[i] =  weights[i]/totalWeight;
 
     }
 }
@@ -973,12 +1624,57 @@ void NBM3P::addStateToObservationGraph(ompl::base::State *state)
 
     stateProperty_[m] = state;
 
-    // Iterate over existing nodes and add edges
-    foreach (Vertex n, boost::vertices(g_))
+    vertexGrid_[gridCellKey(state)].push_back(m);
+
+    // the landmarks seen from a vertex never change, so they are evaluated once here
+    evaluateObservationListForVertex(m);
+
+    const std::vector<unsigned int> &obsList = stateObservationProperty_[m];
+
+    // overlap weight with every vertex that shares a landmark, looked up through the landmark index instead of
+    // comparing against every vertex in the graph (ordered by vertex so edges are added in the same order as before)
+    std::map<Vertex, unsigned int> overlaps;
+
+    if(obsList.empty())
     {
-        if ( m!=n && stateProperty_[m]!=stateProperty_[n])
+        // if both nodes dont see anything, that is also an overlap.
+        for(unsigned int i = 0; i < blindVertices_.size(); i++)
         {
-            addEdgeToObservationGraph(m,n);
+            overlaps[blindVertices_[i]] = 1;
+        }
+
+        blindVertices_.push_back(m);
+    }
+    else
+    {
+        for(unsigned int i = 0; i < obsList.size(); i++)
+        {
+            std::vector<Vertex> &observers = landmarkObservers_[obsList[i]];
+
+            for(unsigned int j = 0; j < observers.size(); j++)
+            {
+                // Check for overlap if they are not looking at the same physical landmark
+                if(si_->distance(stateProperty_[m],stateProperty_[observers[j]]) > 4.0) // 4.0 is 2x the camera range
+                {
+                    // for every overlap, increase weight
+                    overlaps[observers[j]]++;
+                }
+            }
+
+            observers.push_back(m);
+        }
+    }
+
+    for(std::map<Vertex, unsigned int>::const_iterator it = overlaps.begin(); it != overlaps.end(); ++it)
+    {
+        if(stateProperty_[m] != stateProperty_[it->first])
+        {
+            // Add edge if overlap true, with weight = number of overlaps
+            const unsigned int id = maxEdgeID_++;
+
+            const Graph::edge_property_type properties(it->second, id);
+
+            boost::add_edge(m, it->first, properties, g_);
         }
     }
 }
@@ -1018,16 +1714,21 @@ void NBM3P::evaluateObservationListForVertex(const Vertex v)
         obsList.push_back(obs[singleObsSize*i]);
     }
 
+    if(stateObservationProperty_.size() <= v)
+        stateObservationProperty_.resize(v+1);
+
     stateObservationProperty_[v] = obsList;
 }
 
 bool NBM3P::getObservationOverlap(Vertex a, Vertex b, unsigned int &weight)
 {
 
-    // get the list of observations for both vertices
-    evaluateObservationListForVertex(a);
+    // get the list of observations for both vertices, they are cached when the vertex is added
+    if(stateObservationProperty_.size() <= a)
+        evaluateObservationListForVertex(a);
 
-    evaluateObservationListForVertex(b);
+    if(stateObservationProperty_.size() <= b)
+        evaluateObservationListForVertex(b);
 
 
     bool isOverlapping = false;
@@ -1041,22 +1742,22 @@ bool NBM3P::getObservationOverlap(Vertex a, Vertex b, unsigned int &weight)
         return true;
     }
 
+    // Check for overlap if they are not looking at the same physical landmark
+    if(si_->distance(stateProperty_[a],stateProperty_[b]) <= 4.0) // 4.0 is 2x the camera range
+        return false;
+
     // Check if there is an overlap
     for(int i = 0; i < stateObservationProperty_[a].size(); i++)
     {
         for(int j= 0; j < stateObservationProperty_[b].size(); j++)
         {
-            // Check for overlap if they are not looking at the same physical landmark
-            if(si_->distance(stateProperty_[a],stateProperty_[b]) > 4.0) // 4.0 is 2x the camera range
+            if(stateObservationProperty_[a][i] == stateObservationProperty_[b][j])
             {
-                if(stateObservationProperty_[a][i] == stateObservationProperty_[b][j])
-                {
-                    // for every overlap, increase weight
-                    weight++;
+                // for every overlap, increase weight
+                weight++;
 
-                    isOverlapping = true;
+                isOverlapping = true;
 
-                }
             }
         }
     }
@@ -1064,37 +1765,81 @@ bool NBM3P::getObservationOverlap(Vertex a, Vertex b, unsigned int &weight)
     return isOverlapping;
 }
 
+long long NBM3P::gridCellKey(const int cellX, const int cellY)
+{
+    return ((long long)cellX << 32) ^ (long long)(unsigned int)cellY;
+}
+
+long long NBM3P::gridCellKey(const ompl::base::State *state)
+{
+    const int cellX = std::floor(state->as<SE2BeliefSpace::StateType>()->getX() / ompl::magic::NEIGHBORHOOD_RANGE);
+    const int cellY = std::floor(state->as<SE2BeliefSpace::StateType>()->getY() / ompl::magic::NEIGHBORHOOD_RANGE);
+
+    return gridCellKey(cellX, cellY);
+}
+
 std::vector<NBM3P::Vertex> NBM3P::getNeighbors(const ompl::base::State *state)
 {
     std::vector<Vertex> nn;
 
-    foreach(Vertex v, boost::vertices(g_))
+    // The grid cells are as wide as the neighborhood range and the state distance is never less than the planar
+    // distance, so every neighbor lies in the 3x3 block of cells around the state.
+    const int cellX = std::floor(state->as<SE2BeliefSpace::StateType>()->getX() / ompl::magic::NEIGHBORHOOD_RANGE);
+    const int cellY = std::floor(state->as<SE2BeliefSpace::StateType>()->getY() / ompl::magic::NEIGHBORHOOD_RANGE);
+
+    for(int dx = -1; dx <= 1; dx++)
     {
-        if(si_->distance(state, stateProperty_[v]) <  ompl::magic::NEIGHBORHOOD_RANGE)
+        for(int dy = -1; dy <= 1; dy++)
         {
-            nn.push_back(v);
+            std::unordered_map<long long, std::vector<Vertex> >::const_iterator cell = vertexGrid_.find(gridCellKey(cellX+dx, cellY+dy));
+
+            if(cell == vertexGrid_.end())
+                continue;
+
+            foreach(Vertex v, cell->second)
+            {
+                if(si_->distance(state, stateProperty_[v]) <  ompl::magic::NEIGHBORHOOD_RANGE)
+                {
+                    nn.push_back(v);
+                }
+            }
         }
     }
 
+    // same order as a scan over all vertices
+    std::sort(nn.begin(), nn.end());
+
     return nn;
 }
 
-NBM3P::Vertex NBM3P::findTarget(const unsigned int beliefStateIndx)
+void NBM3P::computeModeNeighborhoods(ModeNeighborhoods &neighborhoods)
 {
-    // mapping from index of belief state to its neighbors
-    std::map<unsigned int, std::vector<Vertex> > setOfAllNeighbors;
+    const unsigned int numModes = currentBeliefStates_.size();
+
+    neighborhoods.neighbors.resize(numModes);
+
+    neighborhoods.neighborSets.resize(numModes);
 
-    // find the neighbors of all the belief States
-    for(int i=0; i < currentBeliefStates_.size(); i++)
+    neighborhoods.coverCount.assign(boost::num_vertices(g_), 0);
+
+    for(unsigned int i = 0; i < numModes; i++)
     {
-        std::vector<Vertex> nn;
+        neighborhoods.neighbors[i] = this->getNeighbors(currentBeliefStates_[i]);
 
-        nn = this->getNeighbors(currentBeliefStates_[i]);
+        neighborhoods.neighborSets[i] = std::unordered_set<Vertex>(neighborhoods.neighbors[i].begin(), neighborhoods.neighbors[i].end());
 
-        setOfAllNeighbors[i] = nn; // insert in mapping
+        foreach(Vertex v, neighborhoods.neighbors[i])
+        {
+            neighborhoods.coverCount[v]++;
+        }
     }
+}
 
-    std::vector<Vertex> neighborsOfBelief = setOfAllNeighbors[beliefStateIndx];
+NBM3P::Vertex NBM3P::findTarget(const unsigned int beliefStateIndx, const ModeNeighborhoods &neighborhoods)
+{
+    const std::vector<Vertex> &neighborsOfBelief = neighborhoods.neighbors[beliefStateIndx];
+
+    const std::unordered_set<Vertex> &ownNeighborhood = neighborhoods.neighborSets[beliefStateIndx];
 
      // find the node in the required belief's neighbors that is least similar to nodes in other neighboorhoods
     int targetNodeIndx = -1;
@@ -1103,17 +1848,17 @@ NBM3P::Vertex NBM3P::findTarget(const unsigned int beliefStateIndx)
     // iterate over the nodes in the required belief's neighborhood;
     for(int i = 0; i < neighborsOfBelief.size(); i++)
     {
+        // Summed over all other neighborhoods, an edge to u counts once for every other mode that has u in
+        // its neighborhood. That is the cover count of u, less one if u is also in this mode's neighborhood.
         int w = 0;
 
-        // iterate over all other neighborhoods
-        for(int j = 0; j < setOfAllNeighbors.size(); j++)
+        foreach(Edge e, boost::out_edges(neighborsOfBelief[i], g_))
         {
+            const Vertex u = boost::target(e, g_);
 
-            if(j != beliefStateIndx)
-            {
-                w += calculateIntersectionWithNeighbor(neighborsOfBelief[i],  setOfAllNeighbors[j]);
+            const int otherNeighborhoods = neighborhoods.coverCount[u] - (int)ownNeighborhood.count(u);
 
-            }
+            w += otherNeighborhoods * (int)boost::get(boost::edge_weight, g_, e);
         }
 
         if(w < minWeight)
@@ -1122,17 +1867,6 @@ NBM3P::Vertex NBM3P::findTarget(const unsigned int beliefStateIndx)
             targetNodeIndx = i;
         }
 
-        //If 2 targets have same weight, then choose the closer one
-        /*
-        if(w==minWeight && targetNodeIndx >= 0)
-        {
-            if(si_->distance(currentBeliefStates_[beliefStateIndx],stateProperty_[i]) <= si_->distance(currentBeliefStates_[beliefStateIndx], stateProperty_[targetNodeIndx]))
-            {
-                targetNodeIndx = i;
-            }
-        }
-        */
-
     }
 
     assert(targetNodeIndx >= 0);
@@ -1140,21 +1874,18 @@ NBM3P::Vertex NBM3P::findTarget(const unsigned int beliefStateIndx)
     return neighborsOfBelief[targetNodeIndx];
 }
 
-int NBM3P::calculateIntersectionWithNeighbor(const Vertex v, std::vector<Vertex> neighbors)
+int NBM3P::calculateIntersectionWithNeighbor(const Vertex v, const std::unordered_set<Vertex> &neighbors)
 {
     int w = 0;
 
     foreach(Edge e, boost::out_edges(v, g_))
     {
-        for(int i = 0; i < neighbors.size(); i++)
+        if(neighbors.count(boost::target(e, g_)))
         {
-            if(neighbors[i] == boost::target(e, g_))
-            {
-                // then get the edge weight
-                int edgeWeight =  boost::get(boost::edge_weight, g_, e);
+            // then get the edge weight
+            int edgeWeight =  boost::get(boost::edge_weight, g_, e);
 
-                w += edgeWeight;
-            }
+            w += edgeWeight;
         }
     }
 
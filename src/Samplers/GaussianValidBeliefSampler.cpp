@@ -54,6 +54,27 @@ bool GaussianValidBeliefSampler::sample(ompl::base::State *state)
     bool result = false;
     unsigned int attempts = 0;
     ompl::base::State *temp = si_->allocState();
+
+    // the free side of the pair comes from the map, so only pairs whose other side is blocked are kept
+    if(observabilityMap_ && !observabilityMap_->empty())
+    {
+        do
+        {
+            // most free sides come from the map, the rest uniformly from the whole space
+            if(observabilityMap_->drawFromMap(rng_))
+                observabilityMap_->sample(rng_, state);
+            else
+                sampler_->sampleUniform(state);
+            sampler_->sampleGaussian(temp, state, stddev_);
+            if (!si_->isValid(temp))
+                result = observabilityMap_->isValidAndObservable(state);
+            ++attempts;
+        } while (!result && attempts < attempts_);
+        si_->freeState(temp);
+
+        return result;
+    }
+
     do
     {
         sampler_->sampleUniform(state);
@@ -78,6 +99,24 @@ bool GaussianValidBeliefSampler::sampleNear(ompl::base::State *state, const ompl
     bool result = false;
     unsigned int attempts = 0;
     ompl::base::State *temp = si_->allocState();
+
+    if(observabilityMap_ && !observabilityMap_->empty())
+    {
+        do
+        {
+            // also draw uniformly when no cell near by passed
+            if(!observabilityMap_->drawFromMap(rng_) || !observabilityMap_->sampleNear(rng_, state, near, distance))
+                sampler_->sampleUniformNear(state, near, distance);
+            sampler_->sampleGaussian(temp, state, distance);
+            if (!si_->isValid(temp))
+                result = observabilityMap_->isValidAndObservable(state);
+            ++attempts;
+        } while (!result && attempts < attempts_);
+        si_->freeState(temp);
+
+        return result;
+    }
+
     do
     {
         sampler_->sampleUniformNear(state, near, distance);
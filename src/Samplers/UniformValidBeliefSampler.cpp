@@ -49,6 +49,22 @@ bool UniformValidBeliefSampler::sample(State *state)
 {
     unsigned int attempts = 0;
     bool valid = false;
+
+    if(observabilityMap_ && !observabilityMap_->empty())
+    {
+        do
+        {
+            // most candidates come from the map, the rest uniformly from the whole space
+            if(observabilityMap_->drawFromMap(rng_))
+                observabilityMap_->sample(rng_, state);
+            else
+                sampler_->sampleUniform(state);
+            valid = observabilityMap_->isValidAndObservable(state);
+            ++attempts;
+        } while (!valid && attempts < attempts_);
+        return valid;
+    }
+
     do
     {
         sampler_->sampleUniform(state);
@@ -63,6 +79,20 @@ bool UniformValidBeliefSampler::sampleNear(State *state, const State *near, cons
 {
     unsigned int attempts = 0;
     bool valid = false;
+
+    if(observabilityMap_ && !observabilityMap_->empty())
+    {
+        do
+        {
+            // also draw uniformly when no cell near by passed
+            if(!observabilityMap_->drawFromMap(rng_) || !observabilityMap_->sampleNear(rng_, state, near, distance))
+                sampler_->sampleUniformNear(state, near, distance);
+            valid = observabilityMap_->isValidAndObservable(state);
+            ++attempts;
+        } while (!valid && attempts < attempts_);
+        return valid;
+    }
+
     do
     {
         sampler_->sampleUniformNear(state, near, distance);
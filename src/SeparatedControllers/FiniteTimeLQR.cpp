@@ -86,9 +86,10 @@ ompl::control::Control* FiniteTimeLQR::generateFeedbackControl(const ompl::base:
 
     using namespace arma;
 
-    SpaceType *space; space =  new SpaceType();
+    // one scratch space per thread, its states are recycled by allocState/freeState
+    static thread_local SpaceType space;
 
-    ompl::base::State *relativeState = space->allocState();
+    ompl::base::State *relativeState = space.allocState();
 
     ompl::control::Control* newcontrol;
 
@@ -97,7 +98,7 @@ ompl::control::Control* FiniteTimeLQR::generateFeedbackControl(const ompl::base:
     if(TT <= numT_ - 1)
     {
 
-        space->getRelativeState(nominalXs_[TT], state, relativeState);
+        space.getRelativeState(nominalXs_[TT], state, relativeState);
 
         colvec relativeCfg =  relativeState->as<StateType>()->getArmaData();
 
@@ -115,6 +116,8 @@ ompl::control::Control* FiniteTimeLQR::generateFeedbackControl(const ompl::base:
 
     }
 
+    space.freeState(relativeState);
+
     return newcontrol;
 }
 
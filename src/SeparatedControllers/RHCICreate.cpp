@@ -75,15 +75,17 @@ RHCICreate::generateFeedbackControl(const ompl::base::State *state, const size_t
 
     double distance  = norm(diff.subvec(0,1), 2);
 
-    SpaceType *space;
-    space =  new SpaceType();
+    // one scratch space per thread, its states are recycled by allocState/freeState
+    static thread_local SpaceType space;
 
-    ompl::base::State *relativeState = space->allocState();
+    ompl::base::State *relativeState = space.allocState();
 
-    space->getRelativeState(state, goal_, relativeState);
+    space.getRelativeState(state, goal_, relativeState);
 
     colvec relativeCfg =  relativeState->as<StateType>()->getArmaData();
 
+    space.freeState(relativeState);
+
     //cout<<"RHCICreate controller,                        goal_: "<<endl<<this->goal_.GetArmaData()<<endl;
     //cout<<"RHCICreate controller, relativeCfg bearing (degrees): "<<relativeCfg[2]*180/PI<<endl;
     //cout<<"RHCICreate controller, relativeCfg distance (cm )   : "<<distance*100<<endl;
@@ -67,14 +67,17 @@ ompl::control::Control* StationaryLQR::generateFeedbackControl(const ompl::base:
 
     using namespace arma;
 
-    SpaceType *space; space =  new SpaceType();
+    // one scratch space per thread, its states are recycled by allocState/freeState
+    static thread_local SpaceType space;
 
-    ompl::base::State *relativeState = space->allocState();
+    ompl::base::State *relativeState = space.allocState();
 
-    space->getRelativeState(goal_, state, relativeState);
+    space.getRelativeState(goal_, state, relativeState);
 
     colvec relativeCfg =  relativeState->as<StateType>()->getArmaData();
 
+    space.freeState(relativeState);
+
     // nominal control vec
     colvec nomU = motionModel_->OMPL2ARMA(motionModel_->getZeroControl());
 
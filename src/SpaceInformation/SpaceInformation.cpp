@@ -35,6 +35,7 @@
 /* Authors: Saurav Agarwal */
 
 #include "SpaceInformation/SpaceInformation.h"
+#include "ValidityCheckers/SpatioTemporalValidityChecker.h"
 #include "Visualization/Visualizer.h"
 
 void firm::SpaceInformation::setBelief(const ompl::base::State *state)
@@ -72,6 +73,8 @@ void firm::SpaceInformation::applyControl(const ompl::control::Control *control,
 
     motionModel_->Evolve(trueState_, control, noise, trueState_);
 
+    simulationTime_ += motionModel_->getTimestepSize();
+
     if(showRobot_)
     {
         Visualizer::updateTrueState(trueState_);
@@ -92,3 +95,27 @@ ObservationModelMethod::ObservationType firm::SpaceInformation::getObservation()
 }
 
 
+
+void firm::SpaceInformation::setStateValidityChecker(const ompl::base::StateValidityCheckerPtr &svc)
+{
+    ompl::control::SpaceInformation::setStateValidityChecker(svc);
+
+    timedChecker_ = dynamic_cast<const SpatioTemporalValidityChecker*>(svc.get());
+
+    timedCheckerBase_ = svc.get();
+}
+
+bool firm::SpaceInformation::isValidAtTime(const ompl::base::State *state, double time) const
+{
+    const SpatioTemporalValidityChecker *checker = timedChecker_;
+
+    if(timedCheckerBase_ != stateValidityChecker_.get())
+        checker = dynamic_cast<const SpatioTemporalValidityChecker*>(stateValidityChecker_.get());
+
+    if(checker)
+    {
+        return checker->isValid(state, time);
+    }
+
+    return this->isValid(state);
+}
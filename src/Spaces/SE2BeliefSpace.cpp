@@ -36,6 +36,41 @@
 
 #include "Spaces/SE2BeliefSpace.h"
 
+namespace
+{
+    /** \brief The maximum number of released states a thread keeps around for reuse. */
+    static const std::size_t MAX_RECYCLED_STATES_PER_THREAD = 4096;
+
+    /** \brief Free a belief state and its components without going through the state space.
+        Mirrors RealVectorStateSpace/SO2StateSpace/CompoundStateSpace::freeState. */
+    void destroyBeliefState(SE2BeliefSpace::StateType *state)
+    {
+        RealVectorStateSpace::StateType *pos = state->as<RealVectorStateSpace::StateType>(0);
+        delete[] pos->values;
+        delete pos;
+
+        delete state->as<SO2StateSpace::StateType>(1);
+
+        delete[] state->components;
+        delete state;
+    }
+
+    /** \brief Per-thread list of released belief states. allocState pops from here before
+        going to the heap, freeState pushes back. Whatever is left is freed when the thread exits. */
+    struct RecycledStates
+    {
+        ~RecycledStates()
+        {
+            for(std::size_t i = 0; i < states.size(); i++)
+                destroyBeliefState(states[i]);
+        }
+
+        std::vector<SE2BeliefSpace::StateType*> states;
+    };
+
+    thread_local RecycledStates recycledStates;
+}
+
 double SE2BeliefSpace::StateType::meanNormWeight_  = -1;
 double SE2BeliefSpace::StateType::covNormWeight_   = -1;
 double SE2BeliefSpace::StateType::reachDist_   = -1;
@@ -84,12 +119,25 @@ bool SE2BeliefSpace::StateType::isReached(ompl::base::State *state, bool relaxed
 
 ompl::base::State* SE2BeliefSpace::allocState(void) const
 {
-    StateType *state = new StateType();
-    
-    allocStateComponents(state);
-    
+    StateType *state = NULL;
+
+    if(!recycledStates.states.empty())
+    {
+        state = recycledStates.states.back();
+        recycledStates.states.pop_back();
+
+        state->setXY(0.0, 0.0);
+        state->setCovariance(arma::zeros<arma::mat>(3,3));
+    }
+    else
+    {
+        state = new StateType();
+
+        allocStateComponents(state);
+    }
+
     state->setYaw(0.0);
-    
+
     return state;
 }
 
@@ -103,7 +151,13 @@ void SE2BeliefSpace::copyState(State *destination, const State *source) const
 
 void SE2BeliefSpace::freeState(State *state) const
 {
-    CompoundStateSpace::freeState(state);
+    if(recycledStates.states.size() < MAX_RECYCLED_STATES_PER_THREAD)
+    {
+        recycledStates.states.push_back(state->as<StateType>());
+        return;
+    }
+
+    destroyBeliefState(state->as<StateType>());
 }
 
 double SE2BeliefSpace::distance(const State* state1, const State *state2)
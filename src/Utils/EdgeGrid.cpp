@@ -0,0 +1,132 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2014, Texas A&M University
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Texas A&M University nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+
+/* Authors: Saurav Agarwal */
+
+#include "Utils/EdgeGrid.h"
+#include <algorithm>
+#include <cmath>
+
+firm::EdgeGrid::EdgeGrid(const double cellSize):
+cellSize_(cellSize),
+numEdges_(0)
+{
+}
+
+void firm::EdgeGrid::insert(const std::size_t a, const std::size_t b, const double minX, const double minY, const double maxX, const double maxY)
+{
+    const int x0 = std::floor(minX / cellSize_);
+    const int x1 = std::floor(maxX / cellSize_);
+    const int y0 = std::floor(minY / cellSize_);
+    const int y1 = std::floor(maxY / cellSize_);
+
+    for(int x = x0; x <= x1; x++)
+    {
+        for(int y = y0; y <= y1; y++)
+        {
+            cells_[cellKey(x, y)].push_back(std::make_pair(a, b));
+        }
+    }
+
+    numEdges_++;
+}
+
+void firm::EdgeGrid::remove(const std::size_t a, const std::size_t b, const double minX, const double minY, const double maxX, const double maxY)
+{
+    const VertexPair edge(a, b);
+
+    const int x0 = std::floor(minX / cellSize_);
+    const int x1 = std::floor(maxX / cellSize_);
+    const int y0 = std::floor(minY / cellSize_);
+    const int y1 = std::floor(maxY / cellSize_);
+
+    bool found = false;
+
+    for(int x = x0; x <= x1; x++)
+    {
+        for(int y = y0; y <= y1; y++)
+        {
+            std::unordered_map<long long, std::vector<VertexPair> >::iterator cell = cells_.find(cellKey(x, y));
+
+            if(cell == cells_.end())
+                continue;
+
+            std::vector<VertexPair>::iterator it = std::find(cell->second.begin(), cell->second.end(), edge);
+
+            if(it == cell->second.end())
+                continue;
+
+            cell->second.erase(it);
+
+            found = true;
+
+            if(cell->second.empty())
+                cells_.erase(cell);
+        }
+    }
+
+    if(found && numEdges_ > 0)
+        numEdges_--;
+}
+
+void firm::EdgeGrid::query(const double minX, const double minY, const double maxX, const double maxY, std::vector<VertexPair> &edges) const
+{
+    edges.clear();
+
+    const int x0 = std::floor(minX / cellSize_);
+    const int x1 = std::floor(maxX / cellSize_);
+    const int y0 = std::floor(minY / cellSize_);
+    const int y1 = std::floor(maxY / cellSize_);
+
+    for(int x = x0; x <= x1; x++)
+    {
+        for(int y = y0; y <= y1; y++)
+        {
+            std::unordered_map<long long, std::vector<VertexPair> >::const_iterator cell = cells_.find(cellKey(x, y));
+
+            if(cell != cells_.end())
+                edges.insert(edges.end(), cell->second.begin(), cell->second.end());
+        }
+    }
+
+    // a long edge is filed under many cells
+    std::sort(edges.begin(), edges.end());
+
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+}
+
+long long firm::EdgeGrid::cellKey(const int cellX, const int cellY)
+{
+    return ((long long)cellX << 32) ^ (long long)(unsigned int)cellY;
+}
@@ -36,6 +36,11 @@
 #include "Utils/FIRMUtils.h"
 #include <boost/math/constants/constants.hpp>
 #include <boost/date_time.hpp>
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+#include <algorithm>
+#include <atomic>
+#include <exception>
 #include <utility>
 #include <random>
 #include <tinyxml.h>
@@ -80,7 +85,7 @@ int FIRMUtils::generateRandomIntegerInRange(const int floor, const int ceiling)
     return r;
 }
 
-void FIRMUtils::writeFIRMGraphToXML(const std::vector<std::pair<int,std::pair<arma::colvec,arma::mat> > > nodes, const std::vector<std::pair<std::pair<int,int>,FIRMWeight> > edgeWeights)
+void FIRMUtils::writeFIRMGraphToXML(const std::vector<std::pair<int,std::pair<arma::colvec,arma::mat> > > nodes, const std::vector<std::pair<std::pair<int,int>,FIRMWeight> > edgeWeights, const std::string &pathToXML)
 {
     TiXmlDocument doc;
 
@@ -139,6 +144,12 @@ void FIRMUtils::writeFIRMGraphToXML(const std::vector<std::pair<int,std::pair<ar
 
    }
 
+    if(!pathToXML.empty())
+    {
+        doc.SaveFile(pathToXML);
+        return;
+    }
+
    // Generate time stamp for saving roadmap
     namespace pt = boost::posix_time;
 
@@ -280,3 +291,196 @@ double FIRMUtils::radian2Degree(double rads)
     return rads*180.0/boost::math::constants::pi<double>();
 }
 
+
+namespace
+{
+    /** \brief Worker threads shared by every parallelFor call. The threads outlive the calls, so the thread_local
+        scratch spaces that jobs keep are reused from one batch to the next. */
+    class WorkerPool
+    {
+      public:
+
+        /** \brief The pool is created on first use and never destroyed, a job may still be running when the process exits */
+        static WorkerPool& instance()
+        {
+            static WorkerPool *pool = new WorkerPool(std::max(1u, boost::thread::hardware_concurrency()) - 1);
+
+            return *pool;
+        }
+
+        /** \brief True on a thread that is running parallelFor jobs */
+        static bool inBatch()
+        {
+            return inBatch_;
+        }
+
+        /** \brief Run job(i) for i in [0, numJobs) on the calling thread and up to numHelpers pool threads. The first
+            exception thrown by a job stops the batch and is rethrown here once every thread has left it. */
+        void run(const boost::function<void (unsigned int)> &job, const unsigned int numJobs, const unsigned int numHelpers)
+        {
+            // one batch at a time, callers on other threads wait for their turn
+            boost::mutex::scoped_lock batchLock(batchMutex_);
+
+            {
+                boost::mutex::scoped_lock lock(mutex_);
+
+                job_ = &job;
+                numJobs_ = numJobs;
+                nextJob_ = 0;
+                numHelpers_ = std::min(numHelpers, numThreads_);
+                numJoined_ = 0;
+                error_ = std::exception_ptr();
+                batch_++;
+            }
+
+            wake_.notify_all();
+
+            // the calling thread does its share of the work instead of idling
+            work();
+
+            std::exception_ptr error;
+
+            {
+                boost::mutex::scoped_lock lock(mutex_);
+
+                // helpers that have not woken up yet must not join a finished batch
+                numHelpers_ = numJoined_;
+
+                while(numActive_ > 0)
+                    done_.wait(lock);
+
+                job_ = NULL;
+
+                std::swap(error, error_);
+            }
+
+            if(error)
+                std::rethrow_exception(error);
+        }
+
+      private:
+
+        WorkerPool(const unsigned int numThreads):
+        numThreads_(numThreads),
+        job_(NULL),
+        numJobs_(0),
+        nextJob_(0),
+        numHelpers_(0),
+        numJoined_(0),
+        numActive_(0),
+        batch_(0)
+        {
+            for(unsigned int t = 0; t < numThreads_; t++)
+            {
+                threads_.create_thread(boost::bind(&WorkerPool::workerLoop, this));
+            }
+        }
+
+        /** \brief Wait for batches and help with each one while the batch still takes helpers */
+        void workerLoop()
+        {
+            unsigned long seenBatch = 0;
+
+            boost::mutex::scoped_lock lock(mutex_);
+
+            while(true)
+            {
+                while(batch_ == seenBatch || numJoined_ >= numHelpers_)
+                    wake_.wait(lock);
+
+                seenBatch = batch_;
+                numJoined_++;
+                numActive_++;
+
+                lock.unlock();
+
+                work();
+
+                lock.lock();
+
+                if(--numActive_ == 0)
+                    done_.notify_all();
+            }
+        }
+
+        /** \brief Keep claiming the next job index until none are left */
+        void work()
+        {
+            inBatch_ = true;
+
+            for(unsigned int i = nextJob_++; i < numJobs_; i = nextJob_++)
+            {
+                try
+                {
+                    (*job_)(i);
+                }
+                catch(...)
+                {
+                    boost::mutex::scoped_lock lock(mutex_);
+
+                    if(!error_)
+                        error_ = std::current_exception();
+
+                    // stop handing out jobs, the ones already running finish
+                    nextJob_ = numJobs_;
+                }
+            }
+
+            inBatch_ = false;
+        }
+
+        static thread_local bool inBatch_;
+
+        const unsigned int numThreads_;
+
+        boost::thread_group threads_;
+
+        /** \brief Held by the caller for the whole batch */
+        boost::mutex batchMutex_;
+
+        /** \brief Guards the batch bookkeeping below */
+        boost::mutex mutex_;
+
+        boost::condition_variable wake_, done_;
+
+        const boost::function<void (unsigned int)> *job_;
+
+        unsigned int numJobs_;
+
+        std::atomic<unsigned int> nextJob_;
+
+        /** \brief Pool threads that may still join the current batch, and those that did */
+        unsigned int numHelpers_, numJoined_;
+
+        /** \brief Pool threads working on the current batch */
+        unsigned int numActive_;
+
+        /** \brief Counts the batches, so a pool thread joins each one at most once */
+        unsigned long batch_;
+
+        std::exception_ptr error_;
+    };
+
+    thread_local bool WorkerPool::inBatch_ = false;
+}
+
+void FIRMUtils::parallelFor(const unsigned int numJobs, const boost::function<void (unsigned int)> &job, unsigned int maxThreads)
+{
+    if(maxThreads == 0)
+        maxThreads = std::max(1u, boost::thread::hardware_concurrency());
+
+    const unsigned int numWorkers = std::min(maxThreads, numJobs);
+
+    // a job that calls parallelFor runs its inner loop on its own thread, the pool is already busy with the outer one
+    if(numWorkers <= 1 || WorkerPool::inBatch())
+    {
+        for(unsigned int i = 0; i < numJobs; i++)
+        {
+            job(i);
+        }
+
+        return;
+    }
+
+    WorkerPool::instance().run(job, numJobs, numWorkers - 1);
+}
@@ -0,0 +1,264 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2014, Texas A&M University
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Texas A&M University nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+
+/* Authors: Saurav Agarwal */
+
+#include "Utils/ObservabilityMap.h"
+#include "Utils/FIRMUtils.h"
+#include "Spaces/SE2BeliefSpace.h"
+#include <boost/math/constants/constants.hpp>
+#include <algorithm>
+#include <cmath>
+
+namespace ompl
+{
+    namespace magic
+    {
+        /** \brief Number of poses probed in each cell and heading sector, the sector passes if any of them does */
+        static const unsigned int OBSERVABILITY_MAP_PROBES = 5;
+
+        /** \brief Offsets of the probes from the cell center, in cells. The center comes first, the others catch
+            passages narrower than a cell that miss it */
+        static const double OBSERVABILITY_MAP_PROBE_OFFSETS[OBSERVABILITY_MAP_PROBES][2] = {{0, 0}, {-0.25, -0.25}, {0.25, -0.25}, {-0.25, 0.25}, {0.25, 0.25}};
+
+        /** \brief Share of the draws the samplers take uniformly from the whole space even when the map is used,
+            so that poses in cells where no probe passed can still be sampled */
+        static const double OBSERVABILITY_MAP_UNIFORM_FRACTION = 0.1;
+    }
+}
+
+firm::ObservabilityMap::ObservabilityMap(const SpaceInformation::SpaceInformationPtr &si, const double resolution, const unsigned int numHeadings):
+si_(si),
+resolution_(resolution),
+numHeadings_(std::max(1u, std::min(numHeadings, 8u))),
+originX_(0),
+originY_(0),
+sizeX_(0),
+sizeY_(0)
+{
+    if(numHeadings != numHeadings_)
+        OMPL_WARN("ObservabilityMap: %u heading sectors requested, using %u", numHeadings, numHeadings_);
+}
+
+void firm::ObservabilityMap::build()
+{
+    const double pi = boost::math::constants::pi<double>();
+
+    ompl::base::RealVectorBounds bounds = si_->getStateSpace()->as<SE2BeliefSpace>()->getBounds();
+
+    originX_ = bounds.low[0];
+    originY_ = bounds.low[1];
+
+    sizeX_ = std::max(1, (int)std::ceil((bounds.high[0] - bounds.low[0]) / resolution_));
+    sizeY_ = std::max(1, (int)std::ceil((bounds.high[1] - bounds.low[1]) / resolution_));
+
+    headings_.assign(sizeX_*sizeY_, 0);
+
+    ObservationModelMethod::ObservationModelPointer observationModel = si_->getObservationModel();
+
+    // every column only writes its own cells
+    FIRMUtils::parallelFor(sizeX_, [&](unsigned int i)
+    {
+        std::vector<ompl::base::State*> states;
+
+        std::vector<const ompl::base::State*> validStates;
+
+        // the (row, sector) slot of every valid state
+        std::vector<unsigned int> slots;
+
+        std::vector<bool> observable;
+
+        // a probe only checks the slots that no earlier probe passed
+        for(unsigned int k = 0; k < ompl::magic::OBSERVABILITY_MAP_PROBES; k++)
+        {
+            validStates.clear();
+
+            slots.clear();
+
+            const double x = originX_ + (i + 0.5 + ompl::magic::OBSERVABILITY_MAP_PROBE_OFFSETS[k][0])*resolution_;
+
+            for(int j = 0; j < sizeY_; j++)
+            {
+                const double y = originY_ + (j + 0.5 + ompl::magic::OBSERVABILITY_MAP_PROBE_OFFSETS[k][1])*resolution_;
+
+                for(unsigned int h = 0; h < numHeadings_; h++)
+                {
+                    if(headings_[j*sizeX_ + i] & (1 << h))
+                        continue;
+
+                    if(states.size() == validStates.size())
+                        states.push_back(si_->allocState());
+
+                    ompl::base::State *state = states[validStates.size()];
+
+                    state->as<SE2BeliefSpace::StateType>()->setXYYaw(x, y, -pi + (h + 0.5)*2*pi/numHeadings_);
+
+                    // the last row and column can stick out of the bounds
+                    si_->enforceBounds(state);
+
+                    if(!si_->isValid(state))
+                        continue;
+
+                    validStates.push_back(state);
+
+                    slots.push_back(j*numHeadings_ + h);
+                }
+            }
+
+            // observability of the whole column in one batch
+            observationModel->areStatesObservable(validStates, observable);
+
+            for(unsigned int p = 0; p < validStates.size(); p++)
+            {
+                if(observable[p])
+                    headings_[(slots[p] / numHeadings_)*sizeX_ + i] |= 1 << (slots[p] % numHeadings_);
+            }
+        }
+
+        for(unsigned int p = 0; p < states.size(); p++)
+        {
+            si_->freeState(states[p]);
+        }
+    });
+
+    goodCells_.clear();
+
+    for(unsigned int c = 0; c < headings_.size(); c++)
+    {
+        if(headings_[c])
+            goodCells_.push_back(c);
+    }
+
+    OMPL_INFORM("ObservabilityMap: %u of %u cells are valid and observable", (unsigned int)goodCells_.size(), (unsigned int)headings_.size());
+}
+
+bool firm::ObservabilityMap::sample(ompl::RNG &rng, ompl::base::State *state) const
+{
+    if(goodCells_.empty())
+        return false;
+
+    sampleInCell(rng, goodCells_[rng.uniformInt(0, goodCells_.size()-1)], state);
+
+    return true;
+}
+
+bool firm::ObservabilityMap::sampleNear(ompl::RNG &rng, ompl::base::State *state, const ompl::base::State *near, const double distance) const
+{
+    const SE2BeliefSpace::StateType *n = near->as<SE2BeliefSpace::StateType>();
+
+    const int x0 = std::max(0, (int)std::floor((n->getX() - distance - originX_) / resolution_));
+    const int x1 = std::min(sizeX_-1, (int)std::floor((n->getX() + distance - originX_) / resolution_));
+    const int y0 = std::max(0, (int)std::floor((n->getY() - distance - originY_) / resolution_));
+    const int y1 = std::min(sizeY_-1, (int)std::floor((n->getY() + distance - originY_) / resolution_));
+
+    // reservoir sampling over the passing cells in the window
+    unsigned int numPassing = 0;
+
+    unsigned int chosen = 0;
+
+    for(int y = y0; y <= y1; y++)
+    {
+        for(int x = x0; x <= x1; x++)
+        {
+            const unsigned int cell = y*sizeX_ + x;
+
+            if(!headings_[cell])
+                continue;
+
+            numPassing++;
+
+            if(rng.uniformInt(0, numPassing-1) == 0)
+                chosen = cell;
+        }
+    }
+
+    if(numPassing == 0)
+        return false;
+
+    sampleInCell(rng, chosen, state);
+
+    return true;
+}
+
+bool firm::ObservabilityMap::drawFromMap(ompl::RNG &rng) const
+{
+    return !goodCells_.empty() && rng.uniform01() >= ompl::magic::OBSERVABILITY_MAP_UNIFORM_FRACTION;
+}
+
+bool firm::ObservabilityMap::isValidAndObservable(const ompl::base::State *state) const
+{
+    return si_->isValid(state) && si_->getObservationModel()->isStateObservable(state);
+}
+
+void firm::ObservabilityMap::sampleInCell(ompl::RNG &rng, const unsigned int cell, ompl::base::State *state) const
+{
+    const double pi = boost::math::constants::pi<double>();
+
+    const unsigned char bits = headings_[cell];
+
+    // pick one of the passing sectors uniformly
+    unsigned int numSet = 0;
+
+    for(unsigned int h = 0; h < numHeadings_; h++)
+    {
+        if(bits & (1 << h))
+            numSet++;
+    }
+
+    unsigned int pick = rng.uniformInt(0, numSet-1);
+
+    unsigned int sector = 0;
+
+    for(unsigned int h = 0; h < numHeadings_; h++)
+    {
+        if(!(bits & (1 << h)))
+            continue;
+
+        if(pick-- == 0)
+        {
+            sector = h;
+            break;
+        }
+    }
+
+    const int cellX = cell % sizeX_;
+    const int cellY = cell / sizeX_;
+
+    state->as<SE2BeliefSpace::StateType>()->setXYYaw(originX_ + (cellX + rng.uniform01())*resolution_,
+                                                     originY_ + (cellY + rng.uniform01())*resolution_,
+                                                     -pi + (sector + rng.uniform01())*2*pi/numHeadings_);
+
+    // the last row and column can stick out of the bounds
+    si_->enforceBounds(state);
+}
@@ -0,0 +1,441 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2014, Texas A&M University
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Texas A&M University nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+
+/* Authors: Saurav Agarwal */
+
+#include "Utils/ObservationSignatureIndex.h"
+#include "Utils/FIRMUtils.h"
+#include "Spaces/SE2BeliefSpace.h"
+#include "ObservationModels/CamAruco2DObservationModel.h"
+#include <boost/math/constants/constants.hpp>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <utility>
+
+namespace
+{
+    const char *SIGNATURE_HEADER = "FIRM_OBSERVATION_SIGNATURES";
+
+    /** \brief A candidate may miss this many of the observed landmarks, e.g. one that is at the edge of the camera
+        range or field of view from the indexed pose but not from the true one */
+    const unsigned int SIGNATURE_MAX_MISSED_LANDMARKS = 1;
+}
+
+firm::ObservationSignatureIndex::ObservationSignatureIndex(const double rangeBinSize, const double bearingBinSize, const double gridSize, const double rotationSpacing):
+rangeBinSize_(rangeBinSize),
+bearingBinSize_(bearingBinSize),
+gridSize_(gridSize),
+rotationSpacing_(rotationSpacing),
+fingerprint_(0)
+{
+}
+
+void firm::ObservationSignatureIndex::build(const SpaceInformation::SpaceInformationPtr &si)
+{
+    const double gridSize = gridSize_;
+    const double rotationSpacing = rotationSpacing_;
+
+    ompl::base::RealVectorBounds bounds = si->getStateSpace()->as<SE2BeliefSpace>()->getBounds();
+
+    const double X_1 = bounds.low[0];
+    const double Y_1 = bounds.low[1];
+
+    const int gridSizeX = std::ceil( (bounds.high[0]-X_1) / gridSize);
+    const int gridSizeY = std::ceil( (bounds.high[1]-Y_1) / gridSize);
+
+    const int numHeadings = std::floor(2*boost::math::constants::pi<double>()/rotationSpacing);
+
+    ObservationModelMethod::ObservationModelPointer observationModel = si->getObservationModel();
+
+    // every column of the grid is indexed independently, the columns are concatenated in order afterwards
+    std::vector<std::vector<Pose> > columns(gridSizeX+1);
+
+    FIRMUtils::parallelFor(columns.size(), [&](unsigned int i)
+    {
+        // the valid poses of the column are observed in one batch
+        std::vector<ompl::base::State*> states;
+
+        std::vector<const ompl::base::State*> validStates;
+
+        std::vector<arma::colvec> observations;
+
+        for(int j=0; j <= gridSizeY; j++)
+        {
+            for(int k =0; k < numHeadings; k++ )
+            {
+                Pose pose;
+
+                pose.x = X_1 + i*gridSize;
+                pose.y = Y_1 + j*gridSize;
+                pose.yaw = -boost::math::constants::pi<double>() + k*rotationSpacing;
+
+                if(states.size() == validStates.size())
+                    states.push_back(si->allocState());
+
+                ompl::base::State *state = states[validStates.size()];
+
+                state->as<SE2BeliefSpace::StateType>()->setXYYaw(pose.x, pose.y, pose.yaw);
+
+                if(!si->isValid(state))
+                    continue;
+
+                validStates.push_back(state);
+
+                columns[i].push_back(pose);
+            }
+        }
+
+        observationModel->getObservations(validStates, false, observations);
+
+        for(unsigned int p = 0; p < columns[i].size(); p++)
+        {
+            binObservation(observations[p], columns[i][p].landmarks);
+        }
+
+        for(unsigned int p = 0; p < states.size(); p++)
+        {
+            si->freeState(states[p]);
+        }
+    });
+
+    poses_.clear();
+
+    for(unsigned int i = 0; i < columns.size(); i++)
+    {
+        poses_.insert(poses_.end(), columns[i].begin(), columns[i].end());
+    }
+
+    buildBins();
+
+    fingerprint_ = fingerprint(si);
+
+    OMPL_INFORM("ObservationSignatureIndex: Indexed %u poses under %u landmark bins", (unsigned int)poses_.size(), (unsigned int)bins_.size());
+}
+
+bool firm::ObservationSignatureIndex::load(const std::string &pathToFile, const SpaceInformation::SpaceInformationPtr &si)
+{
+    std::ifstream file(pathToFile.c_str());
+
+    std::string header;
+    double rangeBinSize = 0, bearingBinSize = 0, gridSize = 0, rotationSpacing = 0;
+    unsigned long long savedFingerprint = 0;
+    std::size_t numPoses = 0;
+
+    if(!(file >> header) || header != SIGNATURE_HEADER)
+        return false;
+
+    if(!(file >> rangeBinSize >> bearingBinSize >> gridSize >> rotationSpacing >> savedFingerprint >> numPoses))
+    {
+        OMPL_WARN("ObservationSignatureIndex: %s is in an older format, ignoring it", pathToFile.c_str());
+        return false;
+    }
+
+    if(std::abs(rangeBinSize - rangeBinSize_) > 1e-9 || std::abs(bearingBinSize - bearingBinSize_) > 1e-9)
+    {
+        OMPL_WARN("ObservationSignatureIndex: %s was built with different bin sizes, ignoring it", pathToFile.c_str());
+        return false;
+    }
+
+    if(std::abs(gridSize - gridSize_) > 1e-9 || std::abs(rotationSpacing - rotationSpacing_) > 1e-9)
+    {
+        OMPL_WARN("ObservationSignatureIndex: %s was built on a different grid, ignoring it", pathToFile.c_str());
+        return false;
+    }
+
+    const unsigned long long currentFingerprint = fingerprint(si);
+
+    if(savedFingerprint != currentFingerprint)
+    {
+        OMPL_WARN("ObservationSignatureIndex: %s was built for other landmarks or obstacles, ignoring it", pathToFile.c_str());
+        return false;
+    }
+
+    std::vector<Pose> poses(numPoses);
+
+    for(std::size_t i = 0; i < numPoses; i++)
+    {
+        std::string type;
+        std::size_t numLandmarks = 0;
+
+        if(!(file >> type >> poses[i].x >> poses[i].y >> poses[i].yaw >> numLandmarks) || type != "P")
+            return false;
+
+        poses[i].landmarks.resize(numLandmarks);
+
+        for(std::size_t l = 0; l < numLandmarks; l++)
+        {
+            LandmarkBin &b = poses[i].landmarks[l];
+
+            if(!(file >> b.id >> b.rangeBin >> b.bearingBin))
+                return false;
+        }
+    }
+
+    poses_.swap(poses);
+
+    buildBins();
+
+    fingerprint_ = currentFingerprint;
+
+    return true;
+}
+
+bool firm::ObservationSignatureIndex::save(const std::string &pathToFile) const
+{
+    std::ofstream file(pathToFile.c_str());
+
+    if(!file)
+        return false;
+
+    file.precision(std::numeric_limits<double>::max_digits10);
+
+    file << SIGNATURE_HEADER << " " << rangeBinSize_ << " " << bearingBinSize_ << " " << gridSize_ << " " << rotationSpacing_
+         << " " << fingerprint_ << " " << poses_.size() << "\n";
+
+    for(std::size_t i = 0; i < poses_.size(); i++)
+    {
+        const Pose &pose = poses_[i];
+
+        file << "P " << pose.x << " " << pose.y << " " << pose.yaw << " " << pose.landmarks.size();
+
+        for(std::size_t l = 0; l < pose.landmarks.size(); l++)
+        {
+            file << " " << pose.landmarks[l].id << " " << pose.landmarks[l].rangeBin << " " << pose.landmarks[l].bearingBin;
+        }
+
+        file << "\n";
+    }
+
+    return file.good();
+}
+
+void firm::ObservationSignatureIndex::query(const arma::colvec &observation, std::vector<arma::colvec> &candidates) const
+{
+    candidates.clear();
+
+    std::vector<LandmarkBin> observed;
+
+    binObservation(observation, observed);
+
+    if(observed.empty())
+        return;
+
+    const int numBearingBins = std::ceil(2*boost::math::constants::pi<double>()/bearingBinSize_);
+
+    // number of observed landmarks each pose agrees with
+    std::unordered_map<unsigned int, unsigned int> numMatched;
+
+    std::vector<unsigned int> matches;
+
+    for(std::size_t l = 0; l < observed.size(); l++)
+    {
+        matches.clear();
+
+        // noise and the grid spacing can push the observation into a neighbouring bin, bearing bins wrap around
+        for(int dr = -1; dr <= 1; dr++)
+        {
+            for(int db = -1; db <= 1; db++)
+            {
+                const int bearingBin = (observed[l].bearingBin + db + numBearingBins) % numBearingBins;
+
+                std::unordered_map<long long, std::vector<unsigned int> >::const_iterator it =
+                    bins_.find(binKey(observed[l].id, observed[l].rangeBin + dr, bearingBin));
+
+                if(it != bins_.end())
+                    matches.insert(matches.end(), it->second.begin(), it->second.end());
+            }
+        }
+
+        // a pose counts once per landmark even if it is filed under several of the adjacent bins
+        std::sort(matches.begin(), matches.end());
+        matches.erase(std::unique(matches.begin(), matches.end()), matches.end());
+
+        for(std::size_t m = 0; m < matches.size(); m++)
+            numMatched[matches[m]]++;
+    }
+
+    // a pose has to agree with at least one landmark, so with a single landmark in view it has to match it
+    const unsigned int minMatched = observed.size() > SIGNATURE_MAX_MISSED_LANDMARKS ? observed.size() - SIGNATURE_MAX_MISSED_LANDMARKS : 1;
+
+    std::vector<std::pair<unsigned int, unsigned int> > consistent;
+
+    unsigned int numPartial = 0;
+
+    for(std::unordered_map<unsigned int, unsigned int>::const_iterator it = numMatched.begin(); it != numMatched.end(); ++it)
+    {
+        if(it->second < minMatched)
+            continue;
+
+        consistent.push_back(std::make_pair(it->second, it->first));
+
+        if(it->second < observed.size())
+            numPartial++;
+    }
+
+    if(consistent.empty())
+        return;
+
+    // the poses that match the most landmarks come first, ties in index order so the result is deterministic
+    std::sort(consistent.begin(), consistent.end(), [](const std::pair<unsigned int, unsigned int> &a, const std::pair<unsigned int, unsigned int> &b)
+    {
+        return a.first != b.first ? a.first > b.first : a.second < b.second;
+    });
+
+    if(numPartial > 0)
+        OMPL_INFORM("ObservationSignatureIndex: %u of %u candidates miss one of the %u observed landmarks", numPartial, (unsigned int)consistent.size(), (unsigned int)observed.size());
+
+    candidates.reserve(consistent.size());
+
+    for(std::size_t i = 0; i < consistent.size(); i++)
+    {
+        const Pose &pose = poses_[consistent[i].second];
+
+        arma::colvec xyYaw(3);
+        xyYaw[0] = pose.x;
+        xyYaw[1] = pose.y;
+        xyYaw[2] = pose.yaw;
+
+        candidates.push_back(xyYaw);
+    }
+}
+
+void firm::ObservationSignatureIndex::binObservation(const arma::colvec &observation, std::vector<LandmarkBin> &landmarks) const
+{
+    const int singleObservationDim = CamAruco2DObservationModel::singleObservationDim;
+
+    const int numBearingBins = std::ceil(2*boost::math::constants::pi<double>()/bearingBinSize_);
+
+    landmarks.resize(observation.n_rows / singleObservationDim);
+
+    for(std::size_t l = 0; l < landmarks.size(); l++)
+    {
+        const double range = observation[singleObservationDim*l + 1];
+        const double bearing = observation[singleObservationDim*l + 2];
+
+        landmarks[l].id = observation[singleObservationDim*l];
+        landmarks[l].rangeBin = std::max(0, (int)std::floor(range / rangeBinSize_));
+        landmarks[l].bearingBin = std::min(numBearingBins-1, std::max(0, (int)std::floor((bearing + boost::math::constants::pi<double>()) / bearingBinSize_)));
+    }
+}
+
+void firm::ObservationSignatureIndex::buildBins()
+{
+    bins_.clear();
+
+    // poses are visited in order, so every bin's list comes out sorted
+    for(unsigned int i = 0; i < poses_.size(); i++)
+    {
+        for(std::size_t l = 0; l < poses_[i].landmarks.size(); l++)
+        {
+            const LandmarkBin &b = poses_[i].landmarks[l];
+
+            bins_[binKey(b.id, b.rangeBin, b.bearingBin)].push_back(i);
+        }
+    }
+}
+
+long long firm::ObservationSignatureIndex::binKey(const int id, const int rangeBin, const int bearingBin)
+{
+    return ((long long)id << 32) | ((long long)(rangeBin & 0xFFFF) << 16) | (long long)(bearingBin & 0xFFFF);
+}
+
+unsigned long long firm::ObservationSignatureIndex::fingerprint(const SpaceInformation::SpaceInformationPtr &si) const
+{
+    ompl::base::RealVectorBounds bounds = si->getStateSpace()->as<SE2BeliefSpace>()->getBounds();
+
+    const double X_1 = bounds.low[0];
+    const double Y_1 = bounds.low[1];
+
+    const int gridSizeX = std::ceil( (bounds.high[0]-X_1) / gridSize_);
+    const int gridSizeY = std::ceil( (bounds.high[1]-Y_1) / gridSize_);
+
+    std::vector<double> values;
+
+    values.push_back(X_1);
+    values.push_back(Y_1);
+    values.push_back(bounds.high[0]);
+    values.push_back(bounds.high[1]);
+
+    std::vector<ompl::base::State*> states;
+
+    std::vector<const ompl::base::State*> validStates;
+
+    for(int i=0; i <= gridSizeX; i++)
+    {
+        for(int j=0; j <= gridSizeY; j++)
+        {
+            ompl::base::State *state = si->allocState();
+
+            state->as<SE2BeliefSpace::StateType>()->setXYYaw(X_1 + i*gridSize_, Y_1 + j*gridSize_, 0);
+
+            states.push_back(state);
+
+            const bool valid = si->isValid(state);
+
+            values.push_back(valid);
+
+            if(valid)
+                validStates.push_back(state);
+        }
+    }
+
+    std::vector<arma::colvec> observations;
+
+    si->getObservationModel()->getObservations(validStates, false, observations);
+
+    for(std::size_t p = 0; p < observations.size(); p++)
+    {
+        values.push_back(observations[p].n_rows);
+        values.insert(values.end(), observations[p].begin(), observations[p].end());
+    }
+
+    for(std::size_t p = 0; p < states.size(); p++)
+    {
+        si->freeState(states[p]);
+    }
+
+    // FNV-1a over the bytes of the values
+    unsigned long long hash = 14695981039346656037ULL;
+
+    const unsigned char *bytes = reinterpret_cast<const unsigned char*>(values.data());
+
+    for(std::size_t b = 0; b < values.size()*sizeof(double); b++)
+    {
+        hash = (hash ^ bytes[b]) * 1099511628211ULL;
+    }
+
+    return hash;
+}
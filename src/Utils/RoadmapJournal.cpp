@@ -0,0 +1,424 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2014, Texas A&M University
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Texas A&M University nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+
+/* Authors: Saurav Agarwal */
+
+#include "Utils/RoadmapJournal.h"
+#include "Utils/FIRMUtils.h"
+#include <boost/bind.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/lexical_cast.hpp>
+#include <cstdio>
+#include <limits>
+#include <map>
+#include <sstream>
+
+namespace ompl
+{
+    namespace magic
+    {
+        /** \brief Number of journal records after which the roadmap is compacted into a fresh snapshot */
+        static const unsigned int ROADMAP_JOURNAL_COMPACTION_INTERVAL = 5000;
+    }
+}
+
+namespace
+{
+    const char *JOURNAL_HEADER = "FIRM_ROADMAP_JOURNAL";
+
+    /** \brief Starts a record with enough precision to read back the exact doubles */
+    void beginRecord(std::ostringstream &record, const char type)
+    {
+        record.precision(std::numeric_limits<double>::max_digits10);
+
+        record << type;
+    }
+
+    /** \brief Formats an edge or edge weight record */
+    std::string edgeRecord(const char type, const int a, const int b, const FIRMWeight &w)
+    {
+        std::ostringstream record;
+
+        beginRecord(record, type);
+
+        record << " " << a << " " << b << " " << w.getCost() << " " << w.getSuccessProbability() << "\n";
+
+        return record.str();
+    }
+}
+
+firm::RoadmapJournal::RoadmapJournal(const std::string &pathToJournal) :
+    path_(pathToJournal),
+    generation_(0),
+    queuedJobs_(0),
+    writtenJobs_(0),
+    recordsSinceCompaction_(0),
+    stop_(false)
+{
+    std::ifstream existing(path_.c_str());
+
+    if(!existing || !readHeader(existing, generation_))
+    {
+        existing.close();
+
+        // start a new journal, there is no snapshot underneath it yet
+        generation_ = 0;
+
+        std::ofstream header(path_.c_str(), std::ios::trunc);
+
+        header << JOURNAL_HEADER << " " << generation_ << "\n";
+    }
+
+    file_.open(path_.c_str(), std::ios::app);
+
+    if(!file_)
+        OMPL_ERROR("RoadmapJournal: Could not open %s for writing.", path_.c_str());
+
+    writer_ = boost::thread(boost::bind(&RoadmapJournal::writerLoop, this));
+}
+
+firm::RoadmapJournal::~RoadmapJournal()
+{
+    {
+        boost::mutex::scoped_lock lock(mutex_);
+
+        stop_ = true;
+    }
+
+    workAvailable_.notify_one();
+
+    writer_.join();
+}
+
+void firm::RoadmapJournal::appendNode(const int id, const arma::colvec &x, const arma::mat &cov)
+{
+    std::ostringstream record;
+
+    beginRecord(record, 'N');
+
+    record << " " << id << " " << x.n_rows;
+
+    for(unsigned int i = 0; i < x.n_rows; i++)
+        record << " " << x(i);
+
+    // row major, same order as the c11, c12, ... attributes of the XML roadmap
+    for(unsigned int r = 0; r < cov.n_rows; r++)
+        for(unsigned int c = 0; c < cov.n_cols; c++)
+            record << " " << cov(r,c);
+
+    record << "\n";
+
+    Job job;
+
+    job.record = record.str();
+
+    enqueue(job);
+}
+
+void firm::RoadmapJournal::appendEdge(const int a, const int b, const FIRMWeight &w)
+{
+    Job job;
+
+    job.record = edgeRecord('E', a, b, w);
+
+    enqueue(job);
+}
+
+void firm::RoadmapJournal::appendEdgeWeight(const int a, const int b, const FIRMWeight &w)
+{
+    Job job;
+
+    job.record = edgeRecord('W', a, b, w);
+
+    enqueue(job);
+}
+
+bool firm::RoadmapJournal::needsCompaction() const
+{
+    boost::mutex::scoped_lock lock(mutex_);
+
+    return recordsSinceCompaction_ >= ompl::magic::ROADMAP_JOURNAL_COMPACTION_INTERVAL;
+}
+
+void firm::RoadmapJournal::compact(const NodeList &nodes, const EdgeList &edges)
+{
+    Job job;
+
+    job.snapshot = std::make_shared<const std::pair<NodeList, EdgeList> >(nodes, edges);
+
+    enqueue(job);
+}
+
+void firm::RoadmapJournal::flush()
+{
+    boost::mutex::scoped_lock lock(mutex_);
+
+    while(writtenJobs_ < queuedJobs_)
+        workDone_.wait(lock);
+}
+
+bool firm::RoadmapJournal::isJournal(const std::string &pathToFile)
+{
+    std::ifstream in(pathToFile.c_str());
+
+    unsigned int generation = 0;
+
+    return in && readHeader(in, generation);
+}
+
+bool firm::RoadmapJournal::replay(const std::string &pathToJournal, std::vector<std::pair<int, arma::colvec> > &nodePosList,
+    std::vector<std::pair<int, arma::mat> > &nodeCovarianceList, EdgeList &edgeWeights)
+{
+    std::ifstream in(pathToJournal.c_str());
+
+    unsigned int generation = 0;
+
+    if(!in || !readHeader(in, generation))
+    {
+        OMPL_INFORM("RoadmapJournal: Could not read journal %s.", pathToJournal.c_str());
+        return false;
+    }
+
+    if(generation > 0 && !FIRMUtils::readFIRMGraphFromXML(snapshotPath(pathToJournal, generation), nodePosList, nodeCovarianceList, edgeWeights))
+    {
+        OMPL_ERROR("RoadmapJournal: Snapshot %u of %s is missing.", generation, pathToJournal.c_str());
+        return false;
+    }
+
+    // weight updates refer to edges by their end points
+    std::map<std::pair<int,int>, size_t> edgeIndex;
+
+    for(size_t i = 0; i < edgeWeights.size(); i++)
+        edgeIndex[edgeWeights[i].first] = i;
+
+    unsigned int numRecords = 0;
+
+    bool complete = true;
+
+    std::string line;
+
+    while(std::getline(in, line))
+    {
+        std::istringstream record(line);
+
+        char type = 0;
+
+        record >> type;
+
+        if(type == 'N')
+        {
+            int id = 0;
+            unsigned int dim = 0;
+
+            record >> id >> dim;
+
+            arma::colvec x(dim);
+            arma::mat cov(dim, dim);
+
+            for(unsigned int i = 0; i < dim; i++)
+                record >> x(i);
+
+            for(unsigned int r = 0; r < dim; r++)
+                for(unsigned int c = 0; c < dim; c++)
+                    record >> cov(r,c);
+
+            if(!record)
+            {
+                complete = false;
+                break;
+            }
+
+            nodePosList.push_back(std::make_pair(id, x));
+            nodeCovarianceList.push_back(std::make_pair(id, cov));
+        }
+        else if(type == 'E' || type == 'W')
+        {
+            int a = 0, b = 0;
+            double cost = 0, successProb = 0;
+
+            record >> a >> b >> cost >> successProb;
+
+            if(!record)
+            {
+                complete = false;
+                break;
+            }
+
+            const std::pair<int,int> ab(a, b);
+
+            std::map<std::pair<int,int>, size_t>::iterator it = edgeIndex.find(ab);
+
+            if(type == 'W' && it != edgeIndex.end())
+            {
+                // FIRMWeight::operator= only copies the cost
+                edgeWeights[it->second].second.setCost(cost);
+                edgeWeights[it->second].second.setSuccessProbability(successProb);
+            }
+            else if(type == 'E')
+            {
+                edgeIndex[ab] = edgeWeights.size();
+
+                edgeWeights.push_back(std::make_pair(ab, FIRMWeight(cost, successProb)));
+            }
+        }
+        else
+        {
+            complete = false;
+            break;
+        }
+
+        numRecords++;
+    }
+
+    if(!complete)
+        OMPL_WARN("RoadmapJournal: Ignoring incomplete record after %u records in %s.", numRecords, pathToJournal.c_str());
+
+    OMPL_INFORM("RoadmapJournal: Replayed %u records on top of snapshot %u, %u nodes and %u edges.", numRecords, generation, (unsigned int)nodePosList.size(), (unsigned int)edgeWeights.size());
+
+    return true;
+}
+
+void firm::RoadmapJournal::enqueue(Job &job)
+{
+    {
+        boost::mutex::scoped_lock lock(mutex_);
+
+        pending_.push_back(Job());
+
+        pending_.back().record.swap(job.record);
+
+        pending_.back().snapshot.swap(job.snapshot);
+
+        queuedJobs_++;
+
+        if(pending_.back().snapshot)
+            recordsSinceCompaction_ = 0;
+        else
+            recordsSinceCompaction_++;
+    }
+
+    workAvailable_.notify_one();
+}
+
+void firm::RoadmapJournal::writerLoop()
+{
+    std::deque<Job> batch;
+
+    while(true)
+    {
+        {
+            boost::mutex::scoped_lock lock(mutex_);
+
+            while(pending_.empty() && !stop_)
+                workAvailable_.wait(lock);
+
+            if(pending_.empty())
+                break;
+
+            batch.swap(pending_);
+        }
+
+        for(std::deque<Job>::iterator job = batch.begin(); job != batch.end(); ++job)
+        {
+            if(job->snapshot)
+                writeSnapshot(job->snapshot->first, job->snapshot->second);
+            else
+                file_ << job->record;
+        }
+
+        file_.flush();
+
+        {
+            boost::mutex::scoped_lock lock(mutex_);
+
+            writtenJobs_ += batch.size();
+        }
+
+        workDone_.notify_all();
+
+        batch.clear();
+    }
+}
+
+void firm::RoadmapJournal::writeSnapshot(const NodeList &nodes, const EdgeList &edges)
+{
+    const unsigned int generation = generation_ + 1;
+
+    const std::string snapshot = snapshotPath(path_, generation);
+
+    // Write the new snapshot first, then atomically swap in an empty journal that points at it. If we die in
+    // between, the old journal still points at the old snapshot, which is only removed at the very end.
+    FIRMUtils::writeFIRMGraphToXML(nodes, edges, snapshot + ".tmp");
+
+    std::rename((snapshot + ".tmp").c_str(), snapshot.c_str());
+
+    file_.close();
+
+    {
+        std::ofstream header((path_ + ".tmp").c_str(), std::ios::trunc);
+
+        header << JOURNAL_HEADER << " " << generation << "\n";
+    }
+
+    std::rename((path_ + ".tmp").c_str(), path_.c_str());
+
+    file_.open(path_.c_str(), std::ios::app);
+
+    if(generation_ > 0)
+        std::remove(snapshotPath(path_, generation_).c_str());
+
+    generation_ = generation;
+
+    OMPL_INFORM("RoadmapJournal: Compacted %u nodes and %u edges into %s.", (unsigned int)nodes.size(), (unsigned int)edges.size(), snapshot.c_str());
+}
+
+std::string firm::RoadmapJournal::snapshotPath(const std::string &pathToJournal, const unsigned int generation)
+{
+    return pathToJournal + ".snapshot-" + boost::lexical_cast<std::string>(generation) + ".xml";
+}
+
+bool firm::RoadmapJournal::readHeader(std::istream &in, unsigned int &generation)
+{
+    std::string header;
+
+    in >> header >> generation;
+
+    const bool isHeader = in && header == JOURNAL_HEADER;
+
+    // skip the rest of the header line
+    std::string rest;
+    std::getline(in, rest);
+
+    return isHeader;
+}
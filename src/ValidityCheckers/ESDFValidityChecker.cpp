@@ -0,0 +1,316 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2014, Texas A&M University
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Texas A&M University nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+
+/* Authors: Saurav Agarwal */
+
+#include "ValidityCheckers/ESDFValidityChecker.h"
+#include "Spaces/SE2BeliefSpace.h"
+#include "Utils/FIRMUtils.h"
+#include <boost/math/constants/constants.hpp>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace ompl
+{
+    namespace magic
+    {
+        /** \brief Within this many cells of an obstacle boundary the exact checker decides validity */
+        static const double ESDF_EXACT_CHECK_BAND = 1.0;
+
+        /** \brief Stands in for an infinite squared distance in the distance transform */
+        static const double ESDF_INFINITY = 1e20;
+    }
+}
+
+ESDFValidityChecker::ESDFValidityChecker(const ompl::base::SpaceInformationPtr &si, const ompl::base::StateValidityCheckerPtr &exactChecker, const double resolution,
+                                         const double footprintRadius):
+ompl::base::StateValidityChecker(si),
+exactChecker_(exactChecker),
+resolution_(resolution),
+footprintRadius_(footprintRadius),
+originX_(0),
+originY_(0),
+sizeX_(0),
+sizeY_(0)
+{
+    specs_.clearanceComputationType = ompl::base::StateValidityCheckerSpecs::APPROXIMATE;
+
+    this->build();
+}
+
+bool ESDFValidityChecker::isValid(const ompl::base::State *state) const
+{
+    const SE2BeliefSpace::StateType *x = state->as<SE2BeliefSpace::StateType>();
+
+    double distance = 0;
+
+    if(!signedDistance(x->getX(), x->getY(), distance))
+        return exactChecker_->isValid(state);
+
+    // occupied cells may still hold valid poses, only the free side of the field is trusted
+    if(distance > ompl::magic::ESDF_EXACT_CHECK_BAND*resolution_)
+        return true;
+
+    return exactChecker_->isValid(state);
+}
+
+double ESDFValidityChecker::clearance(const ompl::base::State *state) const
+{
+    const SE2BeliefSpace::StateType *x = state->as<SE2BeliefSpace::StateType>();
+
+    double distance = 0;
+
+    if(!signedDistance(x->getX(), x->getY(), distance))
+        return exactChecker_->clearance(state);
+
+    return distance;
+}
+
+double ESDFValidityChecker::freeRadius(const ompl::base::State *state) const
+{
+    const SE2BeliefSpace::StateType *x = state->as<SE2BeliefSpace::StateType>();
+
+    double distance = 0;
+
+    if(!signedDistance(x->getX(), x->getY(), distance))
+        return 0;
+
+    const double band = ompl::magic::ESDF_EXACT_CHECK_BAND*resolution_;
+
+    if(distance <= band)
+        return 0;
+
+    // neighbouring cells differ by at most one cell, so the interpolated field changes by at most sqrt(2) per meter
+    const double radius = (distance - band) / boost::math::constants::root_two<double>();
+
+    // beyond the raster the exact checker answers
+    const double border = std::min(std::min(x->getX() - originX_, originX_ + sizeX_*resolution_ - x->getX()),
+                                   std::min(x->getY() - originY_, originY_ + sizeY_*resolution_ - x->getY()));
+
+    return std::max(0.0, std::min(radius, border));
+}
+
+bool ESDFValidityChecker::signedDistance(const double x, const double y, double &distance) const
+{
+    // position in cells, relative to the center of the first cell
+    const double fx = (x - originX_) / resolution_ - 0.5;
+    const double fy = (y - originY_) / resolution_ - 0.5;
+
+    if(fx < -0.5 || fy < -0.5 || fx > sizeX_ - 0.5 || fy > sizeY_ - 0.5)
+        return false;
+
+    // bilinear interpolation between the four surrounding cell centers, clamped at the border
+    const int ix = std::max(0, std::min((int)std::floor(fx), sizeX_ - 2));
+    const int iy = std::max(0, std::min((int)std::floor(fy), sizeY_ - 2));
+
+    const int ix1 = std::min(ix + 1, sizeX_ - 1);
+    const int iy1 = std::min(iy + 1, sizeY_ - 1);
+
+    const double tx = std::max(0.0, std::min(fx - ix, 1.0));
+    const double ty = std::max(0.0, std::min(fy - iy, 1.0));
+
+    const double d00 = distance_[iy*sizeX_ + ix];
+    const double d10 = distance_[iy*sizeX_ + ix1];
+    const double d01 = distance_[iy1*sizeX_ + ix];
+    const double d11 = distance_[iy1*sizeX_ + ix1];
+
+    distance = (1 - ty)*((1 - tx)*d00 + tx*d10) + ty*((1 - tx)*d01 + tx*d11);
+
+    return true;
+}
+
+void ESDFValidityChecker::build()
+{
+    ompl::base::RealVectorBounds bounds = si_->getStateSpace()->as<SE2BeliefSpace>()->getBounds();
+
+    originX_ = bounds.low[0];
+    originY_ = bounds.low[1];
+
+    sizeX_ = std::max(1, (int)std::ceil((bounds.high[0] - bounds.low[0]) / resolution_));
+    sizeY_ = std::max(1, (int)std::ceil((bounds.high[1] - bounds.low[1]) / resolution_));
+
+    const unsigned int numCells = sizeX_*sizeY_;
+
+    if(exactChecker_->getSpecs().clearanceComputationType == ompl::base::StateValidityCheckerSpecs::NONE)
+        OMPL_WARN("ESDFValidityChecker: The exact checker does not compute clearance, every cell will be occupied");
+
+    // An obstacle point that some pose in the cell, at any heading, can touch lies within the footprint radius plus half
+    // the cell diagonal of the cell center. The robot at the center is no farther from it than the center, so a cell
+    // whose center has at least that much clearance is free for every pose inside it.
+    const double freeClearance = footprintRadius_ + 0.5*boost::math::constants::root_two<double>()*resolution_;
+
+    // not a vector<bool>, whose elements can not be written from different threads
+    std::vector<unsigned char> occupiedCells(numCells, 0);
+
+    // every column only writes its own cells
+    FIRMUtils::parallelFor(sizeX_, [&](unsigned int i)
+    {
+        ompl::base::State *state = si_->allocState();
+
+        for(int j = 0; j < sizeY_; j++)
+        {
+            state->as<SE2BeliefSpace::StateType>()->setXYYaw(originX_ + (i + 0.5)*resolution_, originY_ + (j + 0.5)*resolution_, 0);
+
+            occupiedCells[j*sizeX_ + i] = exactChecker_->clearance(state) <= freeClearance;
+        }
+
+        si_->freeState(state);
+    });
+
+    std::vector<bool> occupied(numCells);
+
+    unsigned int numOccupied = 0;
+
+    for(unsigned int c = 0; c < numCells; c++)
+    {
+        occupied[c] = occupiedCells[c];
+
+        numOccupied += occupiedCells[c];
+    }
+
+    std::vector<bool> free(numCells);
+
+    for(unsigned int c = 0; c < numCells; c++)
+    {
+        free[c] = !occupied[c];
+    }
+
+    std::vector<double> toOccupied, toFree;
+
+    squaredDistanceTo(occupied, toOccupied);
+
+    squaredDistanceTo(free, toFree);
+
+    // without any occupied (or free) cell the distance is capped at the raster diagonal
+    const double maxSquaredDistance = (double)sizeX_*sizeX_ + (double)sizeY_*sizeY_;
+
+    distance_.resize(numCells);
+
+    for(unsigned int c = 0; c < numCells; c++)
+    {
+        // the boundary lies half way between a free and an occupied cell center
+        if(occupied[c])
+            distance_[c] = -(std::sqrt(std::min(toFree[c], maxSquaredDistance)) - 0.5)*resolution_;
+        else
+            distance_[c] = (std::sqrt(std::min(toOccupied[c], maxSquaredDistance)) - 0.5)*resolution_;
+    }
+
+    OMPL_INFORM("ESDFValidityChecker: %d x %d cells at %f m, %u occupied", sizeX_, sizeY_, resolution_, numOccupied);
+}
+
+void ESDFValidityChecker::squaredDistanceTo(const std::vector<bool> &isTarget, std::vector<double> &squaredDistance) const
+{
+    squaredDistance.resize(sizeX_*sizeY_);
+
+    for(unsigned int c = 0; c < squaredDistance.size(); c++)
+    {
+        squaredDistance[c] = isTarget[c] ? 0 : ompl::magic::ESDF_INFINITY;
+    }
+
+    std::vector<double> f, d, z;
+
+    std::vector<int> v;
+
+    // the 2D transform is a 1D transform along the columns followed by one along the rows
+    f.resize(sizeY_);
+
+    for(int i = 0; i < sizeX_; i++)
+    {
+        for(int j = 0; j < sizeY_; j++)
+        {
+            f[j] = squaredDistance[j*sizeX_ + i];
+        }
+
+        distanceTransform1D(f, d, v, z);
+
+        for(int j = 0; j < sizeY_; j++)
+        {
+            squaredDistance[j*sizeX_ + i] = d[j];
+        }
+    }
+
+    f.resize(sizeX_);
+
+    for(int j = 0; j < sizeY_; j++)
+    {
+        std::copy(squaredDistance.begin() + j*sizeX_, squaredDistance.begin() + (j+1)*sizeX_, f.begin());
+
+        distanceTransform1D(f, d, v, z);
+
+        std::copy(d.begin(), d.end(), squaredDistance.begin() + j*sizeX_);
+    }
+}
+
+void ESDFValidityChecker::distanceTransform1D(const std::vector<double> &f, std::vector<double> &d, std::vector<int> &v, std::vector<double> &z)
+{
+    const int n = f.size();
+
+    d.resize(n);
+    v.resize(n);
+    z.resize(n + 1);
+
+    // lower envelope of the parabolas rooted at (q, f(q))
+    int k = 0;
+
+    v[0] = 0;
+    z[0] = -std::numeric_limits<double>::infinity();
+    z[1] = std::numeric_limits<double>::infinity();
+
+    for(int q = 1; q < n; q++)
+    {
+        double s = ((f[q] + (double)q*q) - (f[v[k]] + (double)v[k]*v[k])) / (2.0*q - 2.0*v[k]);
+
+        while(s <= z[k])
+        {
+            k--;
+            s = ((f[q] + (double)q*q) - (f[v[k]] + (double)v[k]*v[k])) / (2.0*q - 2.0*v[k]);
+        }
+
+        k++;
+        v[k] = q;
+        z[k] = s;
+        z[k+1] = std::numeric_limits<double>::infinity();
+    }
+
+    k = 0;
+
+    for(int q = 0; q < n; q++)
+    {
+        while(z[k+1] < q)
+            k++;
+
+        d[q] = (double)(q - v[k])*(q - v[k]) + f[v[k]];
+    }
+}
@@ -0,0 +1,209 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2014, Texas A&M University
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Texas A&M University nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+
+/* Authors: Saurav Agarwal */
+
+#include "ValidityCheckers/HierarchicalMotionValidator.h"
+#include "ValidityCheckers/ESDFValidityChecker.h"
+#include "ValidityCheckers/SpatioTemporalValidityChecker.h"
+#include "Spaces/SE2BeliefSpace.h"
+#include <algorithm>
+#include <cmath>
+#include <queue>
+
+bool HierarchicalMotionValidator::checkMotion(const ompl::base::State *s1, const ompl::base::State *s2) const
+{
+    // the goal state is the most likely to be invalid, e.g. a node behind a wall
+    if(!si_->isValid(s2))
+    {
+        invalid_++;
+        return false;
+    }
+
+    const int numSteps = si_->getStateSpace()->validSegmentCount(s1, s2);
+
+    const ESDFValidityChecker *esdf = getESDF();
+
+    const double step = stepLength(s1, s2, numSteps);
+
+    ompl::base::State *test = si_->allocState();
+
+    // ranges of steps (lo, hi) whose ends are known to be valid and whose interior is not, widest first
+    std::queue<std::pair<int, int> > ranges;
+
+    int lo = 0, hi = numSteps;
+
+    // the free space around the two ends is skipped right away
+    if(esdf)
+    {
+        lo = std::min(numSteps, std::max(0, freeSteps(esdf, s1, step, numSteps)));
+        hi = std::max(lo, numSteps - std::max(0, freeSteps(esdf, s2, step, numSteps)));
+    }
+
+    ranges.push(std::make_pair(lo, hi));
+
+    bool result = true;
+
+    while(!ranges.empty())
+    {
+        const std::pair<int, int> range = ranges.front();
+
+        ranges.pop();
+
+        if(range.second - range.first < 2)
+            continue;
+
+        const int mid = (range.first + range.second) / 2;
+
+        si_->getStateSpace()->interpolate(s1, s2, (double)mid / numSteps, test);
+
+        int skip = esdf ? freeSteps(esdf, test, step, numSteps) : -1;
+
+        if(skip < 0)
+        {
+            if(!si_->isValid(test))
+            {
+                result = false;
+                break;
+            }
+
+            skip = 0;
+        }
+
+        // the steps within skip of mid are valid as well
+        ranges.push(std::make_pair(range.first, std::max(range.first, mid - skip)));
+        ranges.push(std::make_pair(std::min(range.second, mid + skip), range.second));
+    }
+
+    si_->freeState(test);
+
+    if(result)
+        valid_++;
+    else
+        invalid_++;
+
+    return result;
+}
+
+bool HierarchicalMotionValidator::checkMotion(const ompl::base::State *s1, const ompl::base::State *s2, std::pair<ompl::base::State*, double> &lastValid) const
+{
+    // the first invalid state is wanted here, so the motion is walked in order, striding over free space
+    const int numSteps = si_->getStateSpace()->validSegmentCount(s1, s2);
+
+    const ESDFValidityChecker *esdf = getESDF();
+
+    const double step = stepLength(s1, s2, numSteps);
+
+    ompl::base::State *test = si_->allocState();
+
+    bool result = true;
+
+    int i = 1;
+
+    while(i <= numSteps)
+    {
+        if(i == numSteps)
+            si_->copyState(test, s2);
+        else
+            si_->getStateSpace()->interpolate(s1, s2, (double)i / numSteps, test);
+
+        int skip = esdf ? freeSteps(esdf, test, step, numSteps) : -1;
+
+        if(skip < 0)
+        {
+            if(!si_->isValid(test))
+            {
+                result = false;
+                break;
+            }
+
+            skip = 0;
+        }
+
+        i += skip + 1;
+    }
+
+    si_->freeState(test);
+
+    if(result)
+    {
+        valid_++;
+    }
+    else
+    {
+        // every step before i was checked or skipped as valid
+        lastValid.second = (double)(i - 1) / numSteps;
+
+        if(lastValid.first)
+            si_->getStateSpace()->interpolate(s1, s2, lastValid.second, lastValid.first);
+
+        invalid_++;
+    }
+
+    return result;
+}
+
+const ESDFValidityChecker* HierarchicalMotionValidator::getESDF() const
+{
+    const ompl::base::StateValidityChecker *checker = si_->getStateValidityChecker().get();
+
+    // the time-free checks of a spatio-temporal checker are those of its static checker
+    if(const SpatioTemporalValidityChecker *spatioTemporal = dynamic_cast<const SpatioTemporalValidityChecker*>(checker))
+        checker = spatioTemporal->getStaticChecker().get();
+
+    return dynamic_cast<const ESDFValidityChecker*>(checker);
+}
+
+int HierarchicalMotionValidator::freeSteps(const ESDFValidityChecker *esdf, const ompl::base::State *state, const double stepLength, const int numSteps) const
+{
+    const double radius = esdf->freeRadius(state);
+
+    if(radius <= 0)
+        return -1;
+
+    // a pure rotation stays at this x-y position, which is valid at every heading
+    if(stepLength <= 0)
+        return numSteps;
+
+    // strictly inside the radius
+    return std::max(0, (int)std::ceil(radius / stepLength) - 1);
+}
+
+double HierarchicalMotionValidator::stepLength(const ompl::base::State *s1, const ompl::base::State *s2, const int numSteps) const
+{
+    const SE2BeliefSpace::StateType *from = s1->as<SE2BeliefSpace::StateType>();
+    const SE2BeliefSpace::StateType *to = s2->as<SE2BeliefSpace::StateType>();
+
+    return std::sqrt(std::pow(to->getX() - from->getX(), 2) + std::pow(to->getY() - from->getY(), 2)) / std::max(numSteps, 1);
+}
@@ -0,0 +1,254 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2014, Texas A&M University
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Texas A&M University nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+
+/* Authors: Saurav Agarwal */
+
+#include "ValidityCheckers/SpatioTemporalValidityChecker.h"
+#include "Spaces/SE2BeliefSpace.h"
+#include <algorithm>
+#include <cmath>
+
+namespace ompl
+{
+    namespace magic
+    {
+        /** \brief Side (meters) of the x-y cells of the space-time index */
+        static const double SCHEDULED_OBSTACLE_CELL_SIZE = 1.0;
+
+        /** \brief Length (seconds) of a time bin of the space-time index */
+        static const double SCHEDULED_OBSTACLE_TIME_RESOLUTION = 1.0;
+
+        /** \brief Long schedules use longer time bins so the index does not grow past this many bins */
+        static const unsigned int SCHEDULED_OBSTACLE_MAX_TIME_BINS = 10000;
+    }
+}
+
+SpatioTemporalValidityChecker::SpatioTemporalValidityChecker(const ompl::base::SpaceInformationPtr &si, const ompl::base::StateValidityCheckerPtr &staticChecker,
+                                                             const std::vector<ScheduledObstacle> &obstacles, const double robotRadius):
+ompl::base::StateValidityChecker(si),
+staticChecker_(staticChecker),
+robotRadius_(robotRadius),
+cellSize_(ompl::magic::SCHEDULED_OBSTACLE_CELL_SIZE),
+startTime_(0),
+timeResolution_(ompl::magic::SCHEDULED_OBSTACLE_TIME_RESOLUTION)
+{
+    specs_ = staticChecker_->getSpecs();
+
+    for(unsigned int i = 0; i < obstacles.size(); i++)
+    {
+        if(obstacles[i].route.empty())
+        {
+            OMPL_WARN("SpatioTemporalValidityChecker: Ignoring scheduled obstacle %u, it has no waypoints", i);
+            continue;
+        }
+
+        obstacles_.push_back(obstacles[i]);
+
+        std::vector<Waypoint> &route = obstacles_.back().route;
+
+        std::stable_sort(route.begin(), route.end(), [](const Waypoint &a, const Waypoint &b) { return a.t < b.t; });
+    }
+
+    this->build();
+}
+
+bool SpatioTemporalValidityChecker::isValid(const ompl::base::State *state) const
+{
+    return staticChecker_->isValid(state);
+}
+
+bool SpatioTemporalValidityChecker::isValid(const ompl::base::State *state, const double time) const
+{
+    if(!staticChecker_->isValid(state))
+        return false;
+
+    if(bins_.empty())
+        return true;
+
+    const SE2BeliefSpace::StateType *x = state->as<SE2BeliefSpace::StateType>();
+
+    const std::unordered_map<long long, std::vector<unsigned int> > &cells = bins_[timeBin(time)];
+
+    std::unordered_map<long long, std::vector<unsigned int> >::const_iterator cell =
+        cells.find(cellKey(std::floor(x->getX() / cellSize_), std::floor(x->getY() / cellSize_)));
+
+    if(cell == cells.end())
+        return true;
+
+    for(unsigned int i = 0; i < cell->second.size(); i++)
+    {
+        const ScheduledObstacle &obstacle = obstacles_[cell->second[i]];
+
+        double ox = 0, oy = 0;
+
+        obstaclePosition(obstacle, time, ox, oy);
+
+        const double dx = x->getX() - ox;
+        const double dy = x->getY() - oy;
+        const double minDistance = obstacle.radius + robotRadius_;
+
+        if(dx*dx + dy*dy < minDistance*minDistance)
+            return false;
+    }
+
+    return true;
+}
+
+double SpatioTemporalValidityChecker::clearance(const ompl::base::State *state) const
+{
+    return staticChecker_->clearance(state);
+}
+
+void SpatioTemporalValidityChecker::build()
+{
+    if(obstacles_.empty())
+        return;
+
+    startTime_ = obstacles_[0].route.front().t;
+
+    double endTime = obstacles_[0].route.back().t;
+
+    for(unsigned int i = 1; i < obstacles_.size(); i++)
+    {
+        startTime_ = std::min(startTime_, obstacles_[i].route.front().t);
+        endTime = std::max(endTime, obstacles_[i].route.back().t);
+    }
+
+    unsigned int numBins = std::max(1.0, std::ceil((endTime - startTime_) / timeResolution_));
+
+    if(numBins > ompl::magic::SCHEDULED_OBSTACLE_MAX_TIME_BINS)
+    {
+        numBins = ompl::magic::SCHEDULED_OBSTACLE_MAX_TIME_BINS;
+        timeResolution_ = (endTime - startTime_) / numBins;
+    }
+
+    bins_.assign(numBins, std::unordered_map<long long, std::vector<unsigned int> >());
+
+    for(unsigned int b = 0; b < numBins; b++)
+    {
+        const double t0 = startTime_ + b*timeResolution_;
+        const double t1 = t0 + timeResolution_;
+
+        for(unsigned int i = 0; i < obstacles_.size(); i++)
+        {
+            const ScheduledObstacle &obstacle = obstacles_[i];
+
+            // the obstacle moves in straight lines, so its path during the bin lies in the box of its positions at
+            // the ends of the bin and the waypoints it passes in between
+            double minX = 0, minY = 0, maxX = 0, maxY = 0;
+
+            obstaclePosition(obstacle, t0, minX, minY);
+
+            maxX = minX;
+            maxY = minY;
+
+            double x = 0, y = 0;
+
+            obstaclePosition(obstacle, t1, x, y);
+
+            minX = std::min(minX, x); maxX = std::max(maxX, x);
+            minY = std::min(minY, y); maxY = std::max(maxY, y);
+
+            for(unsigned int w = 0; w < obstacle.route.size(); w++)
+            {
+                const Waypoint &waypoint = obstacle.route[w];
+
+                if(waypoint.t > t0 && waypoint.t < t1)
+                {
+                    minX = std::min(minX, waypoint.x); maxX = std::max(maxX, waypoint.x);
+                    minY = std::min(minY, waypoint.y); maxY = std::max(maxY, waypoint.y);
+                }
+            }
+
+            const double reach = obstacle.radius + robotRadius_;
+
+            const int cx0 = std::floor((minX - reach) / cellSize_);
+            const int cx1 = std::floor((maxX + reach) / cellSize_);
+            const int cy0 = std::floor((minY - reach) / cellSize_);
+            const int cy1 = std::floor((maxY + reach) / cellSize_);
+
+            for(int cx = cx0; cx <= cx1; cx++)
+            {
+                for(int cy = cy0; cy <= cy1; cy++)
+                {
+                    bins_[b][cellKey(cx, cy)].push_back(i);
+                }
+            }
+        }
+    }
+
+    OMPL_INFORM("SpatioTemporalValidityChecker: Indexed %u scheduled obstacles over %u time bins of %f seconds",
+                (unsigned int)obstacles_.size(), numBins, timeResolution_);
+}
+
+void SpatioTemporalValidityChecker::obstaclePosition(const ScheduledObstacle &obstacle, const double time, double &x, double &y)
+{
+    const std::vector<Waypoint> &route = obstacle.route;
+
+    if(time <= route.front().t)
+    {
+        x = route.front().x;
+        y = route.front().y;
+        return;
+    }
+
+    if(time >= route.back().t)
+    {
+        x = route.back().x;
+        y = route.back().y;
+        return;
+    }
+
+    // first waypoint later than time, the one before it is at or before time
+    const std::vector<Waypoint>::const_iterator next =
+        std::upper_bound(route.begin(), route.end(), time, [](const double t, const Waypoint &w) { return t < w.t; });
+
+    const Waypoint &a = *(next - 1);
+    const Waypoint &b = *next;
+
+    const double alpha = (time - a.t) / (b.t - a.t);
+
+    x = a.x + alpha*(b.x - a.x);
+    y = a.y + alpha*(b.y - a.y);
+}
+
+unsigned int SpatioTemporalValidityChecker::timeBin(const double time) const
+{
+    if(time <= startTime_)
+        return 0;
+
+    const double bin = std::floor((time - startTime_) / timeResolution_);
+
+    return std::min(bin, double(bins_.size() - 1));
+}
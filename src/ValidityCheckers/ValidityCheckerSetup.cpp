@@ -0,0 +1,139 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+*
+*  Copyright (c) 2014, Texas A&M University
+*  All rights reserved.
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+*
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the Texas A&M University nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*********************************************************************/
+
+/* Authors: Saurav Agarwal */
+
+#include "ValidityCheckers/ValidityCheckerSetup.h"
+#include "ValidityCheckers/ESDFValidityChecker.h"
+#include <string>
+
+ValidityCheckerSetup::ValidityCheckerSetup():
+esdfResolution_(0),
+esdfRobotRadius_(0),
+scheduledObstacleRobotRadius_(0)
+{
+}
+
+void ValidityCheckerSetup::load(TiXmlNode *planningProblem)
+{
+    // FCL unless a signed distance field is requested
+    esdfResolution_ = 0;
+
+    esdfRobotRadius_ = 0;
+
+    TiXmlNode *child = planningProblem->FirstChild("ValidityChecker");
+
+    if(child && child->ToElement())
+    {
+        std::string checkerType;
+        child->ToElement()->QueryStringAttribute("type", &checkerType);
+
+        if(checkerType == "esdf")
+        {
+            child->ToElement()->QueryDoubleAttribute("resolution", &esdfResolution_);
+
+            child->ToElement()->QueryDoubleAttribute("robotRadius", &esdfRobotRadius_);
+
+            if(esdfResolution_ <= 0)
+            {
+                OMPL_WARN("ESDF validity checker needs a positive resolution, using FCL");
+
+                esdfResolution_ = 0;
+            }
+            else if(esdfRobotRadius_ <= 0)
+            {
+                OMPL_WARN("ESDF validity checker needs a positive robotRadius, using FCL");
+
+                esdfResolution_ = 0;
+            }
+        }
+        else if(!checkerType.empty() && checkerType != "fcl")
+        {
+            OMPL_WARN("Unknown validity checker '%s', using FCL", checkerType.c_str());
+        }
+    }
+
+    loadScheduledObstacles(planningProblem);
+}
+
+ompl::base::StateValidityCheckerPtr ValidityCheckerSetup::allocValidityChecker(const ompl::base::SpaceInformationPtr &si,
+                                                                               const ompl::base::StateValidityCheckerPtr &fclSVC) const
+{
+    ompl::base::StateValidityCheckerPtr svc = fclSVC;
+
+    if(esdfResolution_ > 0)
+        svc = std::make_shared<ESDFValidityChecker>(si, fclSVC, esdfResolution_, esdfRobotRadius_);
+
+    if(!scheduledObstacles_.empty())
+        svc = std::make_shared<SpatioTemporalValidityChecker>(si, svc, scheduledObstacles_, scheduledObstacleRobotRadius_);
+
+    return svc;
+}
+
+void ValidityCheckerSetup::loadScheduledObstacles(TiXmlNode *planningProblem)
+{
+    scheduledObstacles_.clear();
+
+    scheduledObstacleRobotRadius_ = 0;
+
+    TiXmlNode *node = planningProblem->FirstChild("ScheduledObstacles");
+
+    if(!node || !node->ToElement())
+        return;
+
+    node->ToElement()->QueryDoubleAttribute("robotRadius", &scheduledObstacleRobotRadius_);
+
+    for(TiXmlElement *obstacleElement = node->FirstChildElement("Obstacle"); obstacleElement; obstacleElement = obstacleElement->NextSiblingElement("Obstacle"))
+    {
+        SpatioTemporalValidityChecker::ScheduledObstacle obstacle;
+
+        obstacle.radius = 0;
+        obstacleElement->QueryDoubleAttribute("radius", &obstacle.radius);
+
+        for(TiXmlElement *waypointElement = obstacleElement->FirstChildElement("Waypoint"); waypointElement; waypointElement = waypointElement->NextSiblingElement("Waypoint"))
+        {
+            SpatioTemporalValidityChecker::Waypoint waypoint = {0, 0, 0};
+
+            waypointElement->QueryDoubleAttribute("x", &waypoint.x);
+            waypointElement->QueryDoubleAttribute("y", &waypoint.y);
+            waypointElement->QueryDoubleAttribute("t", &waypoint.t);
+
+            obstacle.route.push_back(waypoint);
+        }
+
+        scheduledObstacles_.push_back(obstacle);
+    }
+
+    OMPL_INFORM("Loaded %u scheduled obstacles", (unsigned int)scheduledObstacles_.size());
+}
@@ -74,6 +74,8 @@ int Visualizer::envIndx_   = -1;
 
 bool Visualizer::saveVideo_ = false;
 
+bool Visualizer::enabled_ = true;
+
 void Visualizer::drawLandmark(arma::colvec& landmark)
 {
 
@@ -533,6 +535,12 @@ void Visualizer::drawOpenLoopRRTPaths()
 
 void Visualizer::printRobotPathToFile(std::string path)
 {
+    // the path is recorded while drawing, runs with the visualizer disabled have none
+    if(robotPath_.empty())
+    {
+        OMPL_WARN("Visualizer: No robot path was recorded, nothing written");
+        return;
+    }
 
     std::ofstream outfile;
     outfile.open(path+"RobotPath.csv",std::ios::app);
@@ -44,14 +44,18 @@
  * 
  *  Look at the top of FIRMOMPL.h to see how to include ROS and build. Over there, uncomment #define USE_ROS to allow ROS dependent files to compiled.
  *
+ *  To run without a display pass --headless after the setup file, or configure with -DHEADLESS=ON to build without Qt/OpenGL.
+ *
  * \section install_sec Installation
  *
  *  See README
  *  
  */
 
-#include <QApplication>
-#include <QtGui/QDesktopWidget>
+#ifndef HEADLESS
+    #include <QApplication>
+    #include <QtGui/QDesktopWidget>
+#endif
 #include <boost/thread.hpp>
 #include <iostream>
 #include <istream>
@@ -110,7 +114,9 @@ void plan(const std::string &setupFilePath)
 
     OMPL_INFORM("Execution Terminated.");
 
-    QApplication::quit();
+    #ifndef HEADLESS
+        QApplication::quit();
+    #endif
 
     return;
 }
@@ -179,6 +185,32 @@ int main(int argc, char *argv[])
 
     //arma_rng::set_seed(239645);
 
+    #ifdef HEADLESS
+        const bool headless = true;
+    #else
+        const bool headless = argc > 2 && std::string(argv[2]) == "--headless";
+    #endif
+
+    // without a display plan on this thread, nothing is collected for drawing
+    if(headless)
+    {
+        Visualizer::setEnabled(false);
+
+        #ifndef USE_ROS
+            plan(argv[1]);
+        #endif
+
+        #ifdef USE_ROS
+            planROS(argv[1]);
+        #endif
+
+        OMPL_INFORM("Task Complete");
+
+        exit(0);
+    }
+
+    #ifndef HEADLESS
+
     QApplication app(argc, argv);
 
     MyWindow window;
@@ -208,6 +240,8 @@ int main(int argc, char *argv[])
 
     solveThread.join();
 
+    #endif
+
     OMPL_INFORM("Task Complete");
 
     exit(0);